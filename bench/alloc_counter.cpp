@@ -0,0 +1,31 @@
+#include "alloc_counter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// Relaxed is enough: benchmarks compare counts taken on one thread, or after joining the others
+std::atomic<uint64_t> allocations{0};
+
+} // namespace
+
+uint64_t allocationCount() {
+	return allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
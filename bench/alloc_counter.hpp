@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocations made through the global operator new since the program started. Linking
+// alloc_counter.cpp replaces the allocator of the whole program, so the count includes the
+// standard library's own allocations.
+uint64_t allocationCount();
@@ -0,0 +1,52 @@
+// Move generation throughput and heap-allocation count. Linked with the counting allocator, so
+// any allocation on the generation path shows up in the report.
+#include "alloc_counter.hpp"
+#include "move.hpp"
+#include "movegen.hpp"
+#include "position.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <print>
+
+static constexpr const char* positions[] = {
+	Position::start_fen,
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"R6R/3Q4/1Q4Q1/4Q3/2Q4Q/Q4Q2/pp1Q4/kBNN1KB1 w - - 0 1",
+};
+
+int32_t main() {
+	constexpr int iterations{200000};
+
+	std::println("attack tables built in {} us", Bitboards::init().count());
+
+	uint64_t generated{0};
+	uint64_t total_moves{0};
+	uint64_t heap{0};
+	auto start = std::chrono::steady_clock::now();
+
+	for (const char* fen : positions) {
+		Position pos;
+		pos.setFEN(fen);
+		uint64_t before = allocationCount();
+		for (int i = 0; i < iterations; i++) {
+			MoveList moves;
+			generateLegalMoves(pos, moves);
+			total_moves += moves.size();
+			generated++;
+		}
+		heap += allocationCount() - before;
+	}
+
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+	std::println("positions generated: {}", generated);
+	std::println("moves generated:     {}", total_moves);
+	std::println("positions/second:    {:.0f}", generated / elapsed.count());
+	std::println("heap allocations:    {} ({} per position)", heap,
+			static_cast<double>(heap) / static_cast<double>(generated));
+	return heap == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,128 @@
+// PGN import throughput in games/second, on one thread and on every core, and the heap
+// allocations the reader makes per game. Without an argument it writes an archive of random
+// games first, which also checks that every written game reads back move for move.
+#include "alloc_counter.hpp"
+#include "game.hpp"
+#include "pgn.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <print>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int generated_games{20000};
+
+// Random legal moves until the game ends or reaches 160 plies
+std::string writeArchive(std::vector<size_t>& lengths) {
+	std::mt19937_64 rng{2024};
+	std::string out;
+	PgnHeaders headers;
+	headers.event = "pgn-bench";
+	for (int i = 0; i < generated_games; i++) {
+		Game game;
+		while (!game.isOver() && game.ply() < 160) {
+			const MoveList& moves = game.legalMoves();
+			game.play(moves[rng() % moves.size()]);
+		}
+		if (!game.isOver())
+			game.adjudicate(GameResult::DRAW);
+		headers.round = std::to_string(i + 1);
+		writePgn(out, game, headers);
+		lengths.push_back(game.ply());
+	}
+	return out;
+}
+
+} // namespace
+
+int32_t main(int32_t argc, char* argv[]) {
+	std::string path;
+	std::vector<size_t> lengths;
+	if (argc > 1) {
+		path = argv[1];
+	} else {
+		path = (std::filesystem::temp_directory_path() / "pgn-bench.pgn").string();
+		std::string archive = writeArchive(lengths);
+		FILE* file = std::fopen(path.c_str(), "wb");
+		if (!file || std::fwrite(archive.data(), 1, archive.size(), file) != archive.size()) {
+			std::println(stderr, "cannot write {}", path);
+			return EXIT_FAILURE;
+		}
+		std::fclose(file);
+	}
+
+	PgnFile file;
+	if (!file.open(path)) {
+		std::println(stderr, "cannot open {}", path);
+		return EXIT_FAILURE;
+	}
+	std::string_view text = file.text();
+
+	// One thread: also counts allocations, which only the first games should make
+	uint64_t games{0};
+	uint64_t moves{0};
+	uint64_t broken{0};
+	uint64_t mismatched{0};
+	uint64_t heap{0};
+	auto start = std::chrono::steady_clock::now();
+	{
+		PgnReader reader(text);
+		PgnGame game;
+		while (true) {
+			uint64_t before = allocationCount();
+			if (!reader.next(game))
+				break;
+			if (games >= 100)
+				heap += allocationCount() - before;
+			bool expected = lengths.empty() ||
+					(games < lengths.size() && game.moves.size() == lengths[games]);
+			mismatched += !expected;
+			broken += game.broken;
+			moves += game.moves.size();
+			games++;
+		}
+	}
+	double single = std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+					.count();
+
+	size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	std::atomic<uint64_t> parallel_moves{0};
+	start = std::chrono::steady_clock::now();
+	size_t parallel_games = readPgnParallel(text, threads, [&](size_t, const PgnGame& game) {
+		parallel_moves.fetch_add(game.moves.size(), std::memory_order_relaxed);
+	});
+	double parallel = std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+					  .count();
+
+	double megabytes = static_cast<double>(text.size()) / (1 << 20);
+	std::println("archive:             {} ({:.1f} MB, {} games, {} moves)", path, megabytes, games,
+			moves);
+	std::println("{:<21}{:.0f} games/second, {:.1f} MB/s", "1 thread:", games / single,
+			megabytes / single);
+	std::println("{:<21}{:.0f} games/second, {:.1f} MB/s", std::format("{} threads:", threads),
+			parallel_games / parallel, megabytes / parallel);
+	std::println("heap allocations:    {} after the first 100 games", heap);
+	if (broken)
+		std::println("games with an illegal move or FEN: {}", broken);
+
+	bool ok = parallel_games == games && parallel_moves == moves;
+	if (!lengths.empty()) {
+		ok = ok && games == lengths.size() && mismatched == 0 && broken == 0;
+		std::filesystem::remove(path);
+	}
+	if (!ok)
+		std::println("mismatch: {} games read in parallel, {} read back differently",
+				parallel_games, mismatched);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,113 @@
+// Engine launch latency: time spent starting the child and until it has exited again, with
+// posix_spawn as spawnProcess does it and with the fork() and exec it replaced. The parent first
+// touches a block of memory the size of a loaded GUI, which is what made fork() slow: its cost
+// grows with the page tables it copies, posix_spawn's does not.
+#include "process.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr int iterations{200};
+
+// The way engines were started before spawnProcess: the same pipes, then fork() and exec
+bool forkProcess(const std::string& path, ChildProcess& child) {
+	int in[2];
+	int out[2];
+	if (pipe2(in, O_CLOEXEC) < 0)
+		return false;
+	if (pipe2(out, O_CLOEXEC) < 0) {
+		close(in[0]);
+		close(in[1]);
+		return false;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		dup2(in[0], STDIN_FILENO);
+		dup2(out[1], STDOUT_FILENO);
+		char* argv[] = {const_cast<char*>(path.c_str()), nullptr};
+		execvp(path.c_str(), argv);
+		_exit(127);
+	}
+	close(in[0]);
+	close(out[1]);
+	if (pid < 0) {
+		close(in[1]);
+		close(out[0]);
+		return false;
+	}
+	child = {pid, in[1], out[0]};
+	return true;
+}
+
+struct Timing {
+	double launch_total{0};
+	double launch_max{0};
+	double exit_total{0};
+};
+
+bool measure(const std::string& path,
+		const std::function<bool(const std::string&, ChildProcess&)>& launch, Timing& timing) {
+	for (int i = 0; i < iterations; i++) {
+		ChildProcess child;
+		auto start = std::chrono::steady_clock::now();
+		if (!launch(path, child))
+			return false;
+		double launched = std::chrono::duration<double, std::micro>(
+				std::chrono::steady_clock::now() - start)
+						  .count();
+		closeProcess(child);
+		timing.exit_total += std::chrono::duration<double, std::micro>(
+				std::chrono::steady_clock::now() - start)
+					     .count();
+		timing.launch_total += launched;
+		timing.launch_max = std::max(timing.launch_max, launched);
+	}
+	return true;
+}
+
+} // namespace
+
+int32_t main(int32_t argc, char* argv[]) {
+	std::string path = argc > 1 ? argv[1] : "true";
+	size_t resident_mb{512};
+	if (argc > 2) {
+		std::string_view value{argv[2]};
+		std::from_chars(value.data(), value.data() + value.size(), resident_mb);
+	}
+
+	std::vector<char> resident(resident_mb << 20);
+	std::fill(resident.begin(), resident.end(), 1);
+
+	Timing spawned;
+	Timing forked;
+	auto spawn = [](const std::string& p, ChildProcess& child) { return spawnProcess(p, child); };
+	if (!measure(path, spawn, spawned) || !measure(path, forkProcess, forked)) {
+		std::println(stderr, "cannot start {}", path);
+		return EXIT_FAILURE;
+	}
+
+	std::println("{} with {} MB resident, {} launches each", path, resident_mb, iterations);
+	std::println("{:<13}{:>14}{:>14}{:>18}", "", "launch mean", "launch max", "until exit mean");
+	auto report = [](std::string_view name, const Timing& timing) {
+		std::println("{:<13}{:>11.1f} us{:>11.1f} us{:>15.1f} us", name,
+				timing.launch_total / iterations, timing.launch_max,
+				timing.exit_total / iterations);
+	};
+	report("posix_spawn", spawned);
+	report("fork + exec", forked);
+	return EXIT_SUCCESS;
+}
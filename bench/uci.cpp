@@ -0,0 +1,49 @@
+// UCI info line parsing throughput and heap-allocation count. Engines print thousands of these a
+// second during analysis, so the parser must not allocate.
+#include "alloc_counter.hpp"
+#include "uci.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <print>
+
+static constexpr const char* lines[] = {
+	"info depth 24 seldepth 33 multipv 1 score cp 31 nodes 5263312 nps 1012561 hashfull 512 "
+	"tbhits 0 time 5198 pv e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f8e7 f1e1 b7b5 a4b3 "
+	"d7d6 c2c3 e8g8",
+	"info depth 18 seldepth 25 multipv 2 score cp -12 upperbound nodes 812331 nps 998712 "
+	"time 813 pv d2d4 d7d5",
+	"info depth 31 seldepth 12 multipv 1 score mate 6 nodes 1200331 nps 2031111 time 590 pv "
+	"h5f7 e8d8 f7f8 d8c7 f8e7 c7b6",
+	"info depth 12 currmove g1f3 currmovenumber 3",
+	"info string NNUE evaluation using nn-b1a57edbea57.nnue enabled",
+};
+
+int32_t main() {
+	constexpr int iterations{1000000};
+
+	uint64_t parsed{0};
+	uint64_t pv_moves{0};
+	uint64_t before = allocationCount();
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < iterations; i++) {
+		for (const char* line : lines) {
+			AnalysisUpdate update;
+			if (parseInfoLine(line, update)) {
+				parsed++;
+				pv_moves += update.pv_length;
+			}
+		}
+	}
+
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+	uint64_t heap = allocationCount() - before;
+	uint64_t total = static_cast<uint64_t>(iterations) * std::size(lines);
+	std::println("lines parsed:     {} ({} with a score)", total, parsed);
+	std::println("pv moves:         {}", pv_moves);
+	std::println("lines/second:     {:.0f}", total / elapsed.count());
+	std::println("heap allocations: {}", heap);
+	return heap == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
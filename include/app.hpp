@@ -1,13 +1,13 @@
 #pragma once
 
-#include "piece.hpp"
+#include "game.hpp"
 
 #include <SDL3/SDL.h>
 #include <SDL3_image/SDL_image.h>
-#include <array>
-#include <memory>
 //#include <vector>
 
+struct PieceBitmaps;
+
 class App {
 public:
 	explicit App();
@@ -19,10 +19,20 @@ public:
 	void run();
 
 private:
-	void drawBoardBackground() const;
-	void renderBoard() const;
+	// One board square in render pixels: the board, clicks on it and the piece images all use
+	// this space, which on high-density displays is larger than the window's size in points
+	float squareSize() const;
+	void drawBoardBackground();
+	void renderBoard();
+	// Draws the quads collected so far in one call and starts a new batch
+	void drawBatch();
     void resetBoard();
-    void loadTextures();
+	// Picks up finished piece images and asks for new ones when the square size changed
+	void updatePieceImages();
+	void buildAtlas(const PieceBitmaps& images);
+	// Something on screen changed: draw the next frame, and one more so ImGui can settle its
+	// layout. Anything animated calls this every frame.
+	void invalidate() { dirty_frames = 2; }
 
 private:
 	static constexpr SDL_InitFlags init_flags{SDL_INIT_VIDEO};
@@ -30,8 +40,29 @@ private:
 	static constexpr auto initial_window_width{800};
 	static constexpr auto initial_window_height{800};
 
+	// Woken without anything to draw, the loop still looks at the engine this often
+	static constexpr Sint32 idle_wait_ms{500};
+
 	SDL_Window* window{};
 	SDL_Renderer* renderer{};
+	Uint32 wake_event{};
+
+	int dirty_frames{2};
+	Uint64 frames_rendered{0};
+	Uint64 frames_skipped{0};
+
+	// Shown by the frame counter overlay
+	struct FrameStats {
+		int board_draw_calls{0};
+		int ui_draw_calls{0};
+		// CPU time from starting the frame until it is presented
+		double frame_ms{0};
+		// The last batch of piece images
+		int piece_size{0};
+		double piece_ms{0};
+		int piece_cache_hits{0};
+	} frame_stats;
 
-	std::array<std::unique_ptr<Piece>, 64> board;
+	// The rules live here; App only draws the game and feeds it moves
+	Game game;
 };
\ No newline at end of file
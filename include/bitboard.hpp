@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
+// Bit i is square i of the board array (i = y * 8 + x), so a8 is bit 0 and h1 is bit 63
+using Bitboard = uint64_t;
+
+constexpr Bitboard squareBB(int sq) {
+	return Bitboard{1} << sq;
+}
+
+constexpr int popCount(Bitboard b) {
+	return std::popcount(b);
+}
+
+constexpr int lsb(Bitboard b) {
+	return std::countr_zero(b);
+}
+
+constexpr int popLsb(Bitboard& b) {
+	int sq = lsb(b);
+	b &= b - 1;
+	return sq;
+}
+
+namespace Bitboards {
+
+template <size_t N>
+constexpr std::array<Bitboard, 64> stepAttacks(const int (&steps)[N][2]) {
+	std::array<Bitboard, 64> table{};
+	for (int sq = 0; sq < 64; sq++) {
+		for (const auto& step : steps) {
+			int x = sq % 8 + step[0];
+			int y = sq / 8 + step[1];
+			if (x >= 0 && x < 8 && y >= 0 && y < 8)
+				table[sq] |= squareBB(y * 8 + x);
+		}
+	}
+	return table;
+}
+
+constexpr int knight_steps[8][2] = {
+	{1, 2}, {1, -2}, {-1, 2}, {-1, -2}, {2, 1}, {2, -1}, {-2, 1}, {-2, -1}};
+constexpr int king_steps[8][2] = {
+	{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+// White pawns move towards y == 0
+constexpr int white_pawn_steps[2][2] = {{-1, -1}, {1, -1}};
+constexpr int black_pawn_steps[2][2] = {{-1, 1}, {1, 1}};
+
+} // namespace Bitboards
+
+inline constexpr std::array<Bitboard, 64> knight_attacks{
+	Bitboards::stepAttacks(Bitboards::knight_steps)};
+inline constexpr std::array<Bitboard, 64> king_attacks{
+	Bitboards::stepAttacks(Bitboards::king_steps)};
+// Squares a pawn of the given colour on each square attacks, indexed [color][square]
+inline constexpr std::array<std::array<Bitboard, 64>, 2> pawn_attacks{
+	Bitboards::stepAttacks(Bitboards::white_pawn_steps),
+	Bitboards::stepAttacks(Bitboards::black_pawn_steps)};
+
+// Slider attacks for one square, indexed by the relevant blockers. Without USE_PEXT the index
+// is the classic magic multiply-and-shift, with it the blockers are gathered by BMI2 PEXT.
+struct Magic {
+	Bitboard mask;
+	Bitboard magic;
+	Bitboard* attacks;
+	unsigned shift;
+
+	unsigned index(Bitboard occupied) const {
+#ifdef USE_PEXT
+		return static_cast<unsigned>(_pext_u64(occupied, mask));
+#else
+		return static_cast<unsigned>(((occupied & mask) * magic) >> shift);
+#endif
+	}
+};
+
+extern std::array<Magic, 64> rook_magics;
+extern std::array<Magic, 64> bishop_magics;
+
+inline Bitboard rookAttacks(int sq, Bitboard occupied) {
+	const Magic& m = rook_magics[sq];
+	return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard bishopAttacks(int sq, Bitboard occupied) {
+	const Magic& m = bishop_magics[sq];
+	return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard queenAttacks(int sq, Bitboard occupied) {
+	return rookAttacks(sq, occupied) | bishopAttacks(sq, occupied);
+}
+
+// Squares strictly between two aligned squares, and the whole line through them; both are empty
+// for squares that share no rank, file or diagonal
+extern Bitboard between_bb[64][64];
+extern Bitboard line_bb[64][64];
+
+inline Bitboard betweenBB(int a, int b) {
+	return between_bb[a][b];
+}
+
+inline Bitboard lineBB(int a, int b) {
+	return line_bb[a][b];
+}
+
+namespace Bitboards {
+
+// Fills the slider, between and line tables; must run before the first rook/bishop/queen lookup. Safe to call
+// more than once, only the first call does any work. Returns how long building took.
+std::chrono::microseconds init();
+
+} // namespace Bitboards
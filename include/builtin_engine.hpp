@@ -0,0 +1,71 @@
+#pragma once
+
+#include "engine.hpp"
+#include "position.hpp"
+#include "search.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// In-process engine: runs Search on its own thread so the UI keeps polling getBestMove() exactly
+// like it does with the Stockfish subprocess. With more than one thread the extra ones are Lazy
+// SMP helpers sharing the transposition table; only the main search picks the move.
+class BuiltinEngine : public Engine {
+public:
+	BuiltinEngine();
+	~BuiltinEngine() override;
+
+	bool start() override;
+	void stop() override;
+	void newGame() override;
+	void setSkillLevel(int level) override;
+	void setThreads(int threads) override;
+	void setHashSize(int megabytes) override;
+	void setPosition(const std::string& fen, const std::vector<std::string>& moves = {}) override;
+	void go(int depth = 10, int movetime_ms = 1000) override;
+	void goPonder(int depth = 10, int movetime_ms = 1000) override;
+	void ponderHit() override;
+	std::optional<std::string> getBestMove() override;
+	std::string getPonderMove() const override;
+
+	void setMultiPV(int lines) override;
+	// The search follows the best move only
+	int maxMultiPV() const override { return 1; }
+	void goInfinite() override;
+	void stopSearch() override;
+
+private:
+	void startSearch(SearchLimits limits, bool ponder = false);
+	void reportIteration(const SearchResult& result);
+	void halt();
+
+	Position position;
+	std::vector<uint64_t> game_keys;
+	int max_depth{Search::max_ply};
+
+	std::atomic<bool> stop_flag{false};
+	// Raised once the main search is done, helpers never decide when to stop
+	std::atomic<bool> helper_stop{false};
+	std::atomic<bool> finished{false};
+	Move best_move{Move::none()};
+	Move ponder_reply{Move::none()};
+
+	// Set while a ponder search runs; one that finishes early keeps its answer until ponderHit()
+	std::mutex ponder_mutex;
+	std::condition_variable ponder_cv;
+	bool pondering{false};
+	int ponder_movetime{0};
+	std::chrono::steady_clock::time_point ponder_start;
+	// Ends a ponder search once its movetime has run out after ponderHit()
+	std::jthread ponder_timer;
+	TranspositionTable tt{16};
+	Search search{stop_flag, tt};
+	std::vector<std::unique_ptr<Search>> helpers;
+	std::jthread worker;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "spsc_queue.hpp"
+#include "uci.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Wall-clock cost of bringing an engine up, for the debug overlay; zero until measured
+struct EngineTimings {
+	// Creating the process
+	double spawn_ms{0};
+	// `uci` until `uciok`, and the first `isready` until `readyok`
+	double uciok_ms{0};
+	double readyok_ms{0};
+	// `ucinewgame` until the engine is ready again
+	double newgame_ms{0};
+};
+
+// What the game needs from an opponent: give it a position, start a search and poll for the
+// answer once per frame. Moves are in UCI notation.
+class Engine {
+public:
+	virtual ~Engine() = default;
+
+	// Brings the engine up and waits until it is ready; does nothing if it already runs, so one
+	// session serves every game
+	virtual bool start() = 0;
+	virtual void stop() = 0;
+	// Forgets everything learned in the previous game and waits until the engine is ready
+	virtual void newGame() = 0;
+
+	// 0 (weakest) to 20 (full strength)
+	virtual void setSkillLevel(int level) = 0;
+	// Search threads and transposition table size, the UCI `Threads` and `Hash` options
+	virtual void setThreads(int threads) = 0;
+	virtual void setHashSize(int megabytes) = 0;
+
+	// `fen` may be "startpos". Sending the whole game rather than its last position lets the
+	// engine see repetitions; a call that only adds moves to the previous one is cheap.
+	virtual void setPosition(const std::string& fen, const std::vector<std::string>& moves = {}) = 0;
+	virtual void go(int depth = 10, int movetime_ms = 1000) = 0;
+	// Searches the position set last, which ends with the reply the engine expects, until
+	// ponderHit() or stopSearch(); the limits count from the start of pondering
+	virtual void goPonder(int depth = 10, int movetime_ms = 1000) = 0;
+	// The expected reply was played: the ponder search carries on as a normal one
+	virtual void ponderHit() = 0;
+
+	// Does not block; empty until the search has finished
+	virtual std::optional<std::string> getBestMove() = 0;
+	// The reply expected to the last best move, empty if there is none
+	virtual std::string getPonderMove() const = 0;
+
+	// Analysis: search the position until stopSearch(), reporting through getAnalysis()
+	virtual void setMultiPV(int lines) = 0;
+	// Most lines setMultiPV() can ask for
+	virtual int maxMultiPV() const = 0;
+	virtual void goInfinite() = 0;
+	// Ends the current search but, unlike stop(), leaves the engine running
+	virtual void stopSearch() = 0;
+
+	const EngineTimings& timings() const { return engine_timings; }
+
+	// Does not block; pops the oldest update not yet seen
+	bool getAnalysis(AnalysisUpdate& update) {
+		if (analysis.pop(update))
+			return true;
+		// Re-arm the wake-up before the last look, so an update pushed in between still notifies
+		analysis_pending = false;
+		return analysis.pop(update);
+	}
+
+	// Called from the engine's own thread whenever getBestMove() has something new, so the UI
+	// can sleep instead of polling. Set it before start().
+	void setNotify(std::function<void()> callback) { notify = std::move(callback); }
+
+protected:
+	EngineTimings engine_timings;
+
+	void notifyReady() const {
+		if (notify)
+			notify();
+	}
+
+	// Engines report thousands of updates a second; only the first one after the UI has drained
+	// the queue wakes it. A full queue drops the update.
+	void publishAnalysis(const AnalysisUpdate& update) {
+		if (analysis.push(update) && !analysis_pending.exchange(true))
+			notifyReady();
+	}
+
+	void discardAnalysis() {
+		AnalysisUpdate old;
+		while (getAnalysis(old)) {
+		}
+	}
+
+	// Remembers the game of this setPosition call. Returns how many of `moves` the previous call
+	// already had, or nullopt when the start differs or a move was taken back and the position
+	// has to be rebuilt.
+	std::optional<size_t> continueGame(
+			const std::string& fen, const std::vector<std::string>& moves) {
+		if (fen == game_fen && moves.size() >= game_moves.size() &&
+				std::equal(game_moves.begin(), game_moves.end(), moves.begin())) {
+			size_t known = game_moves.size();
+			game_moves.insert(game_moves.end(), moves.begin() + known, moves.end());
+			return known;
+		}
+		game_fen = fen;
+		game_moves = moves;
+		return std::nullopt;
+	}
+
+private:
+	std::string game_fen;
+	std::vector<std::string> game_moves;
+
+	std::function<void()> notify;
+	SpscQueue<AnalysisUpdate, 256> analysis;
+	std::atomic<bool> analysis_pending{false};
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "process.hpp"
+#include "search.hpp"
+#include "uci.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// A position to analyse, given as the start of the game and the moves played since so the engine
+// knows the history for repetitions
+struct AnalysisJob {
+	std::string fen;
+	std::vector<std::string> moves;
+	SearchLimits limits;
+};
+
+struct AnalysisResult {
+	// Empty when the engine exited before answering
+	std::string best_move;
+	// Last scored info line of the main line
+	AnalysisUpdate info;
+};
+
+// Drives N UCI engine processes for batch analysis. Jobs wait in one queue and go to whichever
+// engine is idle. A single thread multiplexes the output of every engine with epoll, so the pool
+// costs one thread however many engines it runs; callbacks are invoked on that thread.
+class EnginePool {
+public:
+	using Callback = std::function<void(const AnalysisResult&)>;
+
+	// Spawns the engines and starts their handshake; jobs submitted before it completes wait.
+	// With `pin` engine i only runs on CPU i modulo the CPU count.
+	EnginePool(const std::string& path, size_t engines, int hash_mb = 16,
+			std::optional<int> nice = std::nullopt, bool pin = false);
+	~EnginePool();
+	EnginePool(const EnginePool&) = delete;
+	EnginePool& operator=(const EnginePool&) = delete;
+
+	size_t size() const { return engines.size(); }
+
+	void submit(AnalysisJob job, Callback callback);
+	std::future<AnalysisResult> submit(AnalysisJob job);
+
+private:
+	enum class State {
+		// Waiting for uciok, then for the readyok after the options
+		STARTING,
+		SYNCING,
+		IDLE,
+		BUSY,
+		DEAD,
+	};
+
+	struct Pending {
+		AnalysisJob job;
+		Callback callback;
+	};
+
+	// Only touched by the event thread once it runs
+	struct Slot {
+		ChildProcess process;
+		State state{State::DEAD};
+		std::string output;
+		Callback callback;
+		AnalysisResult result;
+	};
+
+	void eventLoop();
+	void readOutput(Slot& slot);
+	void handleLine(Slot& slot, std::string_view line);
+	// Hands queued jobs to idle engines, or fails them once no engine is left
+	void dispatch();
+	// Hands the result to the job's callback
+	void finish(Slot& slot);
+	// Reaps an engine that exited, failing the job it was running
+	void kill(Slot& slot);
+	void shutdown();
+	static void send(const Slot& slot, const std::string& cmd);
+
+	std::vector<Slot> engines;
+	int hash_mb;
+	int epoll_fd{-1};
+	// eventfd that wakes the event thread for new jobs and for shutdown
+	int wake_fd{-1};
+
+	std::mutex queue_mutex;
+	std::deque<Pending> queue;
+	bool stopping{false};
+
+	std::jthread thread;
+};
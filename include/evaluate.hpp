@@ -0,0 +1,11 @@
+#pragma once
+
+#include "position.hpp"
+
+#include <array>
+
+// Centipawn values indexed by PieceType; the king has no material value
+inline constexpr std::array<int, 6> piece_values{100, 500, 320, 330, 900, 0};
+
+// Material plus piece-square bonuses, in centipawns from the side to move's point of view
+int evaluate(const Position& pos);
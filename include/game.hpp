@@ -0,0 +1,91 @@
+#pragma once
+
+#include "movegen.hpp"
+#include "position.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class GameResult : uint8_t { ONGOING, WHITE_WINS, BLACK_WINS, DRAW };
+enum class GameEnd : uint8_t { NONE, CHECKMATE, STALEMATE, REPETITION, FIFTY_MOVES, TIME };
+
+// Base time and increment per side; a zero base plays without clocks
+struct TimeControl {
+	int64_t base_ms{0};
+	int64_t increment_ms{0};
+};
+
+// One game under the full rules: the position, the moves played and how the game ended. Knows
+// nothing about windows or engines, so a process can run as many as it likes.
+class Game {
+public:
+	explicit Game(const std::string& fen = "startpos", TimeControl control = {});
+
+	// `fen` may be "startpos". An invalid FEN leaves the start position and returns false.
+	bool reset(const std::string& fen = "startpos", TimeControl control = {});
+
+	const Position& position() const { return pos; }
+	Color sideToMove() const { return pos.sideToMove(); }
+	// Of the current position, generated once per move
+	const MoveList& legalMoves() const { return legal; }
+	bool isLegal(Move m) const { return legal.contains(m); }
+	// Legal moves of the piece on `from`, queen promotions first
+	void legalMovesFrom(int from, MoveList& moves) const;
+
+	// False, changing nothing, if the game is over or the move is illegal. `spent_ms` is charged
+	// to the mover's clock before the increment is added. If it uses up the clock the move is not
+	// played either, but the game ends there as a loss on time, so false can mean isOver().
+	bool play(Move m, int64_t spent_ms = 0);
+	bool play(std::string_view uci, int64_t spent_ms = 0);
+	// Undoes the last move, clocks included; false at the start of the game
+	bool takeBack();
+
+	// Settles a game the rules have not ended yet, for resignation and adjudication
+	void adjudicate(GameResult game_result);
+
+	bool isOver() const { return result != GameResult::ONGOING; }
+	GameResult outcome() const { return result; }
+	GameEnd endReason() const { return end; }
+	// "White to move", "Check!", "Checkmate!" ...
+	std::string status() const;
+
+	// "startpos" or the FEN the game started from, and the moves since, in UCI notation: what an
+	// engine's `position` command needs
+	const std::string& startFen() const { return start_fen; }
+	const std::vector<std::string>& moves() const { return uci_moves; }
+	size_t ply() const { return history.size(); }
+
+	bool timed() const { return time_control.base_ms > 0; }
+	int64_t timeLeft(Color side) const { return clocks[static_cast<int>(side)]; }
+	const TimeControl& timeControl() const { return time_control; }
+
+private:
+	struct PlayedMove {
+		Move move;
+		UndoInfo undo;
+		// The mover's clock before the move
+		int64_t clock;
+	};
+
+	// Regenerates the legal moves and decides whether the game is over
+	void update();
+
+	Position pos;
+	std::string start_fen;
+	MoveList legal;
+	std::vector<PlayedMove> history;
+	std::vector<std::string> uci_moves;
+	// The key of every position reached, the current one last, for repetition detection
+	std::vector<uint64_t> keys;
+
+	TimeControl time_control;
+	std::array<int64_t, 2> clocks{};
+
+	GameResult result{GameResult::ONGOING};
+	GameEnd end{GameEnd::NONE};
+};
+
+const char* toString(GameResult result);
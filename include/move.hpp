@@ -0,0 +1,91 @@
+#pragma once
+
+#include "piece.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 16-bit move: bits 0-5 origin square, 6-11 destination, 12-15 flags
+class Move {
+public:
+	enum Flag : uint8_t {
+		QUIET = 0,
+		DOUBLE_PUSH = 1,
+		KING_CASTLE = 2,
+		QUEEN_CASTLE = 3,
+		CAPTURE = 4,
+		EP_CAPTURE = 5,
+		PROMO_KNIGHT = 8,
+		PROMO_BISHOP = 9,
+		PROMO_ROOK = 10,
+		PROMO_QUEEN = 11,
+		PROMO_KNIGHT_CAPTURE = 12,
+		PROMO_BISHOP_CAPTURE = 13,
+		PROMO_ROOK_CAPTURE = 14,
+		PROMO_QUEEN_CAPTURE = 15,
+	};
+
+	// Left uninitialised on purpose so a MoveList does not zero its whole buffer
+	Move() = default;
+	constexpr Move(int from, int to, uint8_t flags = QUIET)
+		: data(static_cast<uint16_t>(from | (to << 6) | (flags << 12))) {
+	}
+
+	static constexpr Move none() { return Move(0, 0); }
+
+	constexpr int from() const { return data & 0x3F; }
+	constexpr int to() const { return (data >> 6) & 0x3F; }
+	constexpr uint8_t flags() const { return data >> 12; }
+	constexpr bool isCapture() const { return flags() & CAPTURE; }
+	constexpr bool isPromotion() const { return flags() & PROMO_KNIGHT; }
+	constexpr bool isCastle() const { return flags() == KING_CASTLE || flags() == QUEEN_CASTLE; }
+	constexpr PieceType promotion() const {
+		constexpr PieceType types[] = {
+			PieceType::KNIGHT, PieceType::BISHOP, PieceType::ROOK, PieceType::QUEEN};
+		return types[flags() & 3];
+	}
+	constexpr uint16_t raw() const { return data; }
+
+	constexpr bool operator==(const Move& other) const { return data == other.data; }
+
+	// Long algebraic notation as used by UCI, e.g. "e2e4" or "e7e8q"
+	std::string toUci() const;
+
+private:
+	uint16_t data;
+};
+
+// Fixed-capacity move buffer meant to live on the stack. 218 is the most legal moves any
+// position has; the extra room covers the pseudo-legal moves the piece generators produce.
+class MoveList {
+public:
+	static constexpr size_t capacity{256};
+
+	void push_back(Move m) { moves[count++] = m; }
+	void clear() { count = 0; }
+	// Only shrinks; used to drop moves filtered out in place
+	void resize(size_t n) { count = n; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	Move& operator[](size_t i) { return moves[i]; }
+	const Move& operator[](size_t i) const { return moves[i]; }
+	Move* begin() { return moves.data(); }
+	Move* end() { return moves.data() + count; }
+	const Move* begin() const { return moves.data(); }
+	const Move* end() const { return moves.data() + count; }
+
+	bool contains(Move m) const {
+		for (Move x : *this) {
+			if (x == m)
+				return true;
+		}
+		return false;
+	}
+
+private:
+	std::array<Move, capacity> moves;
+	size_t count{0};
+};
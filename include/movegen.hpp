@@ -0,0 +1,11 @@
+#pragma once
+
+#include "move.hpp"
+#include "position.hpp"
+
+// Appends every legal move of the side to move. Pins and checks are worked out once for the
+// position; only king moves and en passant need an extra attack query.
+void generateLegalMoves(const Position& pos, MoveList& moves);
+
+// Pieces of the side to move that cannot leave the line between their king and an enemy slider
+Bitboard pinnedPieces(const Position& pos);
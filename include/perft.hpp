@@ -0,0 +1,50 @@
+#pragma once
+
+#include "move.hpp"
+#include "position.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+// Subtree node counts shared by all perft threads without locks. Each entry stores its data
+// next to the key XORed with that data, so a torn read from two racing writers fails the key
+// check instead of returning a wrong count. Buckets hold a depth-preferred and an always-replace
+// slot.
+class PerftHash {
+public:
+	explicit PerftHash(size_t megabytes);
+
+	bool probe(uint64_t key, int depth, uint64_t& nodes) const;
+	void store(uint64_t key, int depth, uint64_t nodes);
+	void clear();
+	size_t entryCount() const { return mask + 1; }
+
+private:
+	struct Entry {
+		std::atomic<uint64_t> check;
+		// node count in the top 56 bits, depth in the low 8
+		std::atomic<uint64_t> data;
+	};
+
+	std::unique_ptr<Entry[]> entries;
+	size_t mask{0};
+};
+
+// Leaf nodes of the legal move tree `depth` plies below `pos`. The last ply is counted from the
+// size of the move list instead of being played out.
+uint64_t perft(Position& pos, int depth, PerftHash* hash = nullptr);
+
+struct DivideEntry {
+	Move move;
+	uint64_t nodes;
+};
+
+// perft split by root move, in move generation order. With a pool the subtrees two plies down
+// are spread over its workers.
+std::vector<DivideEntry> perftDivide(
+		Position& pos, int depth, PerftHash* hash = nullptr, ThreadPool* pool = nullptr);
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "game.hpp"
+#include "move.hpp"
+#include "position.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A PGN archive mapped read-only into memory, so files of several gigabytes are parsed in place
+// instead of being copied into a string first
+class PgnFile {
+public:
+	PgnFile() = default;
+	~PgnFile();
+	PgnFile(const PgnFile&) = delete;
+	PgnFile& operator=(const PgnFile&) = delete;
+
+	bool open(const std::string& path);
+	bool isOpen() const { return data != nullptr; }
+	std::string_view text() const { return {data, size}; }
+
+private:
+	void unmap();
+
+	const char* data{nullptr};
+	size_t size{0};
+};
+
+// Views into the text being read; escaped quotes stay escaped
+struct PgnTag {
+	std::string_view name;
+	std::string_view value;
+};
+
+// One game as read from an archive. The tags point into the text, so they live as long as it
+// does. Reading a whole archive into the same PgnGame keeps its buffers, and once they are large
+// enough a game costs no allocations beyond its FEN tag, if any.
+struct PgnGame {
+	std::vector<PgnTag> tags;
+	// The FEN tag, or the standard start position
+	Position start;
+	// Main line only: comments, variations and NAGs are skipped
+	std::vector<Move> moves;
+	GameResult result{GameResult::ONGOING};
+	// Of the game's first byte in the text
+	size_t offset{0};
+	// An invalid FEN or illegal move; `moves` keeps the moves before it
+	bool broken{false};
+
+	// Empty if the game has no such tag
+	std::string_view tag(std::string_view name) const;
+};
+
+// Reads games one after another from PGN text. SAN is matched against the legal moves of the
+// position it is played in, straight from the text.
+class PgnReader {
+public:
+	// `base_offset` is where `pgn_text` starts in the file, when it is a chunk of one
+	explicit PgnReader(std::string_view pgn_text, size_t base_offset = 0);
+
+	// False once the text holds no further game
+	bool next(PgnGame& game);
+
+private:
+	void skipSpace();
+	void readTag(PgnGame& game);
+	// Plays one movetext token; false when it ends the game
+	bool readToken(PgnGame& game, std::string_view token, Position& pos);
+
+	std::string_view text;
+	size_t base;
+	size_t offset{0};
+	Position start_position;
+};
+
+// Up to `count` offsets at which games start, the first 0, splitting `text` into chunks of about
+// equal size. A game is taken to start at a '[' that opens a line after a blank one, which is how
+// every PGN export separates games, so a chunk can only split a game whose comment does the same.
+std::vector<size_t> splitPgn(std::string_view text, size_t count);
+
+// Reads `text` in up to `threads` chunks at once. `visit` runs on the chunk's thread with the
+// chunk's index and each game in it, in file order within the chunk. Returns the number of games.
+size_t readPgnParallel(std::string_view text, size_t threads,
+		const std::function<void(size_t chunk, const PgnGame& game)>& visit);
+
+// The Seven Tag Roster but for Result, which the game supplies
+struct PgnHeaders {
+	std::string event{"?"};
+	std::string site{"?"};
+	std::string date{"????.??.??"};
+	std::string round{"?"};
+	std::string white{"?"};
+	std::string black{"?"};
+	// Written after the roster in this order, e.g. TimeControl or Termination
+	std::vector<std::pair<std::string, std::string>> extra;
+};
+
+// Appends `game` to `out` as PGN: the tags, SetUp and FEN if it did not start from the standard
+// position, and SAN movetext wrapped at 80 columns. `comments` holds nothing or one per move,
+// written in braces after it.
+void writePgn(std::string& out, const Game& game, const PgnHeaders& headers,
+		const std::vector<std::string>& comments = {});
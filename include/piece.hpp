@@ -1,9 +1,6 @@
 #pragma once
 
 #include <cstdint>
-#include <vector>
-#include <memory>
-#include <array>
 
 enum class Color : uint8_t { WHITE, BLACK };
 enum class PieceType : uint8_t { PAWN, ROOK, KNIGHT, BISHOP, QUEEN, KING };
@@ -14,17 +11,23 @@ struct BoardCoordinates {
     bool operator==(const BoardCoordinates& other) const { return x == other.x && y == other.y; }
 };
 
+class Move;
+class MoveList;
+class Position;
+
+// Pieces are lightweight views over a Position: they are built on the stack for the square being
+// queried and read everything else from the position's bitboards
 class Piece {
 public:
-    using BoardArray = std::array<std::unique_ptr<Piece>, 64>;
-
-	virtual std::vector<BoardCoordinates> getPossibleMoves(const BoardArray& board) const = 0;
+	virtual void getPossibleMoves(const Position& board, MoveList& moves) const = 0;
     
 	virtual Color getColor() const = 0;
     virtual PieceType getType() const = 0;
 	virtual BoardCoordinates getPosition() const = 0;
     virtual void setPosition(BoardCoordinates new_pos) = 0;
-    virtual bool hasMoved() const { return true; } 
     
 	virtual ~Piece() = default;
-};
\ No newline at end of file
+};
+
+// Appends the pseudo-legal moves of whatever stands on `sq`, nothing if the square is empty
+void getPieceMoves(const Position& board, int sq, MoveList& moves);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "position.hpp"
+#include "thread_pool.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The twelve pieces rasterized at one size
+struct PieceBitmaps {
+	int size{0};
+	// size * size RGBA pixels per PieceCode, empty if the image could not be loaded
+	std::array<std::vector<uint8_t>, no_piece> pixels;
+	// Pieces read from the disk cache rather than rasterized, and the wall time of the batch
+	int cache_hits{0};
+	double time_ms{0};
+};
+
+// Rasterizes the piece SVGs (wP.svg ... bK.svg) on a worker pool. Every image is also written to
+// the cache directory as raw RGBA, named by its size and a hash of the SVG, so a later launch at
+// the same size reads it back and never runs the SVG parser.
+class PieceImages {
+public:
+	PieceImages(std::string svg_directory, std::string blob_directory);
+	~PieceImages();
+	PieceImages(const PieceImages&) = delete;
+	PieceImages& operator=(const PieceImages&) = delete;
+
+	// Starts rasterizing every piece at size x size pixels. `done` is called from a worker once
+	// the whole batch is ready. Call only when not busy().
+	void request(int size, std::function<void()> done);
+	bool busy() const { return in_flight != nullptr; }
+	// Does not block; the finished batch once, then null until the next one finishes
+	std::unique_ptr<PieceBitmaps> takeFinished();
+	// Waits for the batch in flight and stops the workers
+	void shutdown();
+
+private:
+	void load(PieceBitmaps& bitmaps, PieceCode piece) const;
+
+	std::string directory;
+	std::string cache_directory;
+	// Created on the first request, so nothing runs before the window exists
+	std::unique_ptr<ThreadPool> pool;
+
+	std::unique_ptr<PieceBitmaps> in_flight;
+	std::atomic<int> remaining{0};
+	std::atomic<bool> finished{false};
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "move.hpp"
+#include "position.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+// Read-only Polyglot opening book. The .bin file is memory-mapped and searched in place: it is a
+// sorted array of 16-byte big-endian entries, so a probe is one binary search.
+//
+// Polyglot hashes positions with its own table of 781 Random64 numbers rather than our Zobrist
+// keys. The table is published with the format specification and compiled in; it is checked
+// against the test keys of the specification before the first book is opened.
+class PolyglotBook {
+public:
+	PolyglotBook() = default;
+	~PolyglotBook();
+	PolyglotBook(const PolyglotBook&) = delete;
+	PolyglotBook& operator=(const PolyglotBook&) = delete;
+
+	bool open(const std::string& path);
+	bool isOpen() const { return entries != nullptr; }
+	size_t size() const { return entry_count; }
+
+	// Positions later than `moves` full moves into the game are not looked up
+	void setMaxMoves(int moves) { max_moves = moves; }
+
+	uint64_t key(const Position& pos) const;
+	// A legal book move picked with probability proportional to its weight; Move::none() if the
+	// position is not in the book or too deep into the game
+	Move pick(const Position& pos, std::mt19937_64& rng) const;
+
+private:
+	struct Entry {
+		uint64_t key;
+		uint16_t move;
+		uint16_t weight;
+	};
+
+	Entry entryAt(size_t i) const;
+	Move decodeMove(const Position& pos, uint16_t move) const;
+	void unmap();
+
+	int max_moves{12};
+
+	const unsigned char* entries{nullptr};
+	size_t entry_count{0};
+	size_t mapping_size{0};
+};
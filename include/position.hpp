@@ -0,0 +1,130 @@
+#pragma once
+
+#include "bitboard.hpp"
+#include "move.hpp"
+#include "piece.hpp"
+
+#include <array>
+#include <string>
+#include <string_view>
+
+// Colour and type packed into one byte for the square-indexed mailbox
+using PieceCode = uint8_t;
+constexpr PieceCode no_piece{12};
+
+constexpr PieceCode makePieceCode(Color c, PieceType t) {
+	return static_cast<PieceCode>(static_cast<int>(c) * 6 + static_cast<int>(t));
+}
+
+constexpr Color colorOf(PieceCode p) {
+	return p < 6 ? Color::WHITE : Color::BLACK;
+}
+
+constexpr PieceType typeOf(PieceCode p) {
+	return static_cast<PieceType>(p % 6);
+}
+
+constexpr Color operator~(Color c) {
+	return c == Color::WHITE ? Color::BLACK : Color::WHITE;
+}
+
+constexpr int toSquare(BoardCoordinates c) {
+	return c.y * 8 + c.x;
+}
+
+constexpr BoardCoordinates toCoordinates(int sq) {
+	return {static_cast<int8_t>(sq % 8), static_cast<int8_t>(sq / 8)};
+}
+
+enum CastlingRight : uint8_t {
+	WHITE_OO = 1,
+	WHITE_OOO = 2,
+	BLACK_OO = 4,
+	BLACK_OOO = 8,
+};
+
+// State makeMove cannot recompute when the move is taken back
+struct UndoInfo {
+	uint64_t key;
+	PieceCode captured;
+	uint8_t castling;
+	int8_t ep_square;
+	int halfmove_clock;
+};
+
+// FEN letter for a piece, upper case for white
+char pieceToChar(PieceCode p);
+std::string squareToString(int sq);
+
+class Position {
+public:
+	static constexpr auto start_fen{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"};
+
+	Position();
+	bool setFEN(std::string_view fen);
+	std::string fen() const;
+
+	Bitboard occupied() const { return occupied_bb; }
+	Bitboard pieces(Color c) const { return color_bb[static_cast<int>(c)]; }
+	Bitboard pieces(PieceType t) const { return type_bb[static_cast<int>(t)]; }
+	Bitboard pieces(Color c, PieceType t) const { return pieces(c) & pieces(t); }
+	PieceCode pieceAt(int sq) const { return mailbox[sq]; }
+	bool isEmpty(int sq) const { return mailbox[sq] == no_piece; }
+	int kingSquare(Color c) const { return lsb(pieces(c, PieceType::KING)); }
+
+	Color sideToMove() const { return side_to_move; }
+	bool canCastle(CastlingRight cr) const { return castling & cr; }
+	uint8_t castlingRights() const { return castling; }
+	// Set only when a pawn of the side to move stands beside the pawn that just advanced two
+	// squares, so positions that differ in nothing else share a key and count as repetitions
+	int epSquare() const { return ep_square; }
+	int halfmoveClock() const { return halfmove_clock; }
+	int fullmoveNumber() const { return fullmove_number; }
+	// Zobrist key of pieces, side to move, castling rights and en-passant file
+	uint64_t key() const { return zobrist_key; }
+
+	// Pieces of both colours attacking `sq`, with sliders seeing through to `occupied`
+	Bitboard attackersTo(int sq, Bitboard occupied) const;
+	Bitboard attackersTo(int sq) const { return attackersTo(sq, occupied_bb); }
+	// Looks outward from `sq` with each piece pattern and stops at the first attacker found
+	bool isAttacked(int sq, Color by) const;
+	// Enemy pieces giving check to the side to move
+	Bitboard checkers() const {
+		return attackersTo(kingSquare(side_to_move)) & pieces(~side_to_move);
+	}
+	bool inCheck() const { return isAttacked(kingSquare(side_to_move), ~side_to_move); }
+
+	// Plays a pseudo-legal move for the side to move, including the rook hop of a castle,
+	// the captured pawn of en passant and promotion of a pawn reaching the last rank. The key
+	// is updated incrementally; the returned state lets undoMove restore the position.
+	UndoInfo makeMove(Move m);
+	void undoMove(Move m, const UndoInfo& undo);
+
+	// Rebuilds the flags of a UCI move string from the board, Move::none() if it is malformed
+	// or there is no piece of the side to move on its origin square
+	Move parseMove(std::string_view uci) const;
+
+private:
+	uint64_t computeKey() const;
+	void verifyKey() const;
+	// Whether a pawn of `by` could take en passant on `sq`
+	bool canTakeEnPassant(Color by, int sq) const {
+		return pawn_attacks[static_cast<int>(~by)][sq] & pieces(by, PieceType::PAWN);
+	}
+	void clear();
+	void putPiece(PieceCode p, int sq);
+	void removePiece(int sq);
+	void movePiece(int from, int to);
+
+	std::array<Bitboard, 6> type_bb{};
+	std::array<Bitboard, 2> color_bb{};
+	Bitboard occupied_bb{};
+	std::array<PieceCode, 64> mailbox{};
+
+	Color side_to_move{Color::WHITE};
+	uint8_t castling{};
+	int8_t ep_square{-1};
+	int halfmove_clock{};
+	int fullmove_number{1};
+	uint64_t zobrist_key{};
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// A child process talking over its stdin and stdout
+struct ChildProcess {
+	int pid{-1};
+	// Write end of the child's stdin
+	int stdin_fd{-1};
+	// Non-blocking read end of the child's stdout
+	int stdout_fd{-1};
+};
+
+// Scheduling limits for a child, so engines do not compete with the render thread
+struct ProcessLimits {
+	// CPUs the child may run on; empty leaves the affinity alone
+	std::vector<int> cpus;
+	// Nice level from 0 to 19; unset leaves the priority alone
+	std::optional<int> nice;
+};
+
+// Starts `path`, looked up in PATH, with posix_spawn; false if the pipes or the spawn fail. The
+// child gets only its stdin, stdout and stderr, every other descriptor is closed. Writing to a
+// child that has died raises SIGPIPE, so programs that run engines ignore it in main().
+bool spawnProcess(const std::string& path, ChildProcess& child, const ProcessLimits& limits = {});
+// Applies `limits` to every thread of a running child; false if any of them refused. Raising
+// the priority back needs privileges.
+bool setProcessLimits(int pid, const ProcessLimits& limits);
+// Closes both pipes and waits for the child to exit; one still running half a second later is
+// killed, so a hung engine cannot block its caller
+void closeProcess(ChildProcess& child);
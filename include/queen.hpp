@@ -4,7 +4,7 @@
 class Queen : public Piece {
 public:
     Queen(Color c, BoardCoordinates pos);
-	std::vector<BoardCoordinates> getPossibleMoves(const BoardArray& board) const override;
+	void getPossibleMoves(const Position& board, MoveList& moves) const override;
 	Color getColor() const override;
     PieceType getType() const override;
 	BoardCoordinates getPosition() const override;
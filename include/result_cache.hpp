@@ -0,0 +1,87 @@
+#pragma once
+
+#include "search.hpp"
+#include "uci.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// What an engine answered for a position
+struct CachedResult {
+	UciMove best_move;
+	// From the side to move's point of view, in centipawns or moves to mate
+	int score{0};
+	bool mate{false};
+	int depth{0};
+};
+
+// Least recently used engine answers keyed by the Zobrist key of the position and the limits of
+// the search. Answers saved to disk are memory-mapped by open() and found by binary search, so a
+// large file costs nothing until it is used; hits are promoted into the in-memory list.
+class ResultCache {
+public:
+	explicit ResultCache(size_t capacity);
+	~ResultCache();
+	ResultCache(const ResultCache&) = delete;
+	ResultCache& operator=(const ResultCache&) = delete;
+
+	// `variant` tells apart engines and settings that answer the same limits differently
+	bool lookup(uint64_t position, const SearchLimits& limits, uint32_t variant,
+			CachedResult& result);
+	void store(uint64_t position, const SearchLimits& limits, uint32_t variant,
+			const CachedResult& result);
+
+	// Maps a file written by save(); false if it is missing or not a cache file
+	bool open(const std::string& path);
+	// Forgets the mapped file; answers already in memory are kept
+	void close() { unmap(); }
+	// Writes the most recent `capacity` answers, sorted for open(). The file is replaced by
+	// rename, so saving over the mapped file is safe.
+	bool save(const std::string& path) const;
+
+	// Answers held in memory, not counting the mapped file
+	size_t size() const { return entries.size(); }
+	uint64_t hits() const { return hit_count; }
+	uint64_t misses() const { return miss_count; }
+
+private:
+	// On-disk layout, also used in memory
+	struct Record {
+		uint64_t position;
+		// depth | movetime << 8 | variant << 40
+		uint64_t limits;
+		int32_t score;
+		uint8_t depth;
+		uint8_t mate;
+		uint8_t move_length;
+		char move[5];
+	};
+	static_assert(sizeof(Record) == 32);
+
+	struct KeyHash {
+		size_t operator()(const std::pair<uint64_t, uint64_t>& key) const {
+			return key.first ^ (key.second * 0x9E3779B97F4A7C15ull);
+		}
+	};
+
+	static uint64_t packLimits(const SearchLimits& limits, uint32_t variant);
+	const Record* findMapped(uint64_t position, uint64_t limits) const;
+	void insert(const Record& record);
+	void unmap();
+
+	size_t capacity;
+	// Most recently used first
+	std::list<Record> entries;
+	std::unordered_map<std::pair<uint64_t, uint64_t>, std::list<Record>::iterator, KeyHash> index;
+
+	const Record* mapped{nullptr};
+	size_t mapped_count{0};
+	void* mapping{nullptr};
+	size_t mapping_size{0};
+
+	uint64_t hit_count{0};
+	uint64_t miss_count{0};
+};
@@ -4,15 +4,13 @@
 class Rook : public Piece {
 public:
     Rook(Color c, BoardCoordinates pos);
-	std::vector<BoardCoordinates> getPossibleMoves(const BoardArray& board) const override;
+	void getPossibleMoves(const Position& board, MoveList& moves) const override;
 	Color getColor() const override;
     PieceType getType() const override;
 	BoardCoordinates getPosition() const override;
     void setPosition(BoardCoordinates new_pos) override;
-	bool hasMoved() const override;
 
 private:
 	BoardCoordinates position;
 	Color color;
-	bool has_moved;
 };
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "move.hpp"
+#include "position.hpp"
+
+#include <string>
+#include <string_view>
+
+// Finds the legal move a SAN token such as "Nbd7", "exd8=Q+" or "O-O" stands for; Move::none()
+// if no legal move or more than one matches. Check and annotation suffixes are ignored.
+Move parseSan(const Position& pos, std::string_view san);
+
+// SAN of a legal move, e.g. "Nbd7", "exd8=Q" or "O-O", with "+" or "#" when it checks or mates
+std::string toSan(const Position& pos, Move m);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "move.hpp"
+#include "position.hpp"
+#include "tt.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct SearchLimits {
+	int depth{64};
+	// 0 searches until `depth` is reached or the caller raises the stop flag
+	int movetime_ms{0};
+};
+
+struct SearchResult {
+	Move best{Move::none()};
+	int score{0};
+	int depth{0};
+	uint64_t nodes{0};
+	uint64_t time_ms{0};
+	// Followed through the transposition table from the root, so it may end early
+	MoveList pv;
+};
+
+// Iterative-deepening alpha-beta with quiescence search. Moves are tried hash move first, then
+// captures by MVV-LVA, killers and history. The search polls `stop` and its own deadline and,
+// once either fires, answers with the last completed iteration.
+//
+// Several Searches sharing one table form a Lazy SMP search: they all search the same root and
+// only meet through the table. Helpers (thread_id > 0) skip every other depth so they run ahead
+// of the main thread and fill the table with deeper results.
+class Search {
+public:
+	static constexpr int max_ply{64};
+	static constexpr int infinity{32001};
+	static constexpr int mate_score{32000};
+
+	Search(const std::atomic<bool>& stop_flag, TranspositionTable& table, int thread_id = 0);
+
+	// `game_keys` are the keys of the positions played before `root`, for repetition draws
+	SearchResult run(const Position& root, const SearchLimits& limits,
+			const std::vector<uint64_t>& game_keys = {});
+
+	// Called on the searching thread after every completed iteration
+	void onIteration(std::function<void(const SearchResult&)> callback) {
+		iteration_callback = std::move(callback);
+	}
+
+private:
+	using MoveScores = std::array<int, MoveList::capacity>;
+
+	int alphaBeta(int depth, int ply, int alpha, int beta);
+	int quiescence(int ply, int alpha, int beta);
+	void scoreMoves(const MoveList& moves, int ply, Move first, MoveScores& scores) const;
+	bool isRepetition() const;
+	bool shouldStop();
+	void extractPV(const Position& root, MoveList& pv) const;
+
+	const std::atomic<bool>& stop;
+	TranspositionTable& tt;
+	std::function<void(const SearchResult&)> iteration_callback;
+	int id;
+	bool aborted{false};
+	Position pos;
+	std::vector<uint64_t> keys;
+	uint64_t nodes{0};
+
+	std::chrono::steady_clock::time_point deadline;
+	bool has_deadline{false};
+
+	Move root_first{Move::none()};
+	Move root_best{Move::none()};
+	std::array<std::array<Move, 2>, max_ply> killers{};
+	// Cutoffs caused by quiet moves, indexed [side][from][to]
+	std::array<std::array<std::array<int, 64>, 64>, 2> history{};
+};
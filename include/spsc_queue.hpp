@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded single-producer single-consumer ring. Each side owns one index and only reads the other
+// side's, so neither ever waits; push fails when the ring is full. One slot stays unused to tell
+// full from empty.
+template <typename T, size_t N>
+class SpscQueue {
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+	bool push(T value) {
+		size_t tail = write_index.load(std::memory_order_relaxed);
+		size_t next = (tail + 1) & (N - 1);
+		if (next == read_index.load(std::memory_order_acquire))
+			return false;
+		slots[tail] = std::move(value);
+		write_index.store(next, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& value) {
+		size_t head = read_index.load(std::memory_order_relaxed);
+		if (head == write_index.load(std::memory_order_acquire))
+			return false;
+		value = std::move(slots[head]);
+		read_index.store((head + 1) & (N - 1), std::memory_order_release);
+		return true;
+	}
+
+private:
+	std::array<T, N> slots{};
+	// Separate cache lines so the producer and consumer do not invalidate each other
+	alignas(64) std::atomic<size_t> write_index{0};
+	alignas(64) std::atomic<size_t> read_index{0};
+};
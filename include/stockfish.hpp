@@ -1,30 +1,86 @@
 #pragma once
 
+#include "engine.hpp"
+#include "process.hpp"
+#include "spsc_queue.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 #include <optional>
 
-class Stockfish {
+class Stockfish : public Engine {
 public:
     Stockfish();
-    ~Stockfish();
+    ~Stockfish() override;
 
-    bool start(const std::string& path = "stockfish");
-    void stop();
-    
-    void setSkillLevel(int level);
+    bool start() override { return start("stockfish"); }
+    bool start(const std::string& path);
+    void stop() override;
+    // Applied to the running engine and to every later start
+    void setProcessLimits(const ProcessLimits& limits);
+    void newGame() override;
+
+    void setSkillLevel(int level) override;
+    void setThreads(int threads) override;
+    void setHashSize(int megabytes) override;
 
-    void setPosition(const std::string& fen, const std::vector<std::string>& moves = {});
-    void go(int depth = 10, int movetime_ms = 1000);
+    void setPosition(const std::string& fen, const std::vector<std::string>& moves = {}) override;
+    void go(int depth = 10, int movetime_ms = 1000) override;
+    void goPonder(int depth = 10, int movetime_ms = 1000) override;
+    void ponderHit() override;
     
-    std::optional<std::string> getBestMove();
+    std::optional<std::string> getBestMove() override;
+    std::string getPonderMove() const override;
+
+    void setMultiPV(int lines) override;
+    // The highest value Stockfish accepts for its MultiPV option
+    int maxMultiPV() const override { return 500; }
+    void goInfinite() override;
+    void stopSearch() override;
 
 private:
     void writeCommand(const std::string& cmd);
+    // Blocks in poll() on the engine's stdout and wake_fd, splits the output into lines and
+    // queues every bestmove and parsed info line for the UI thread
+    void readLoop();
+    void handleLine(std::string_view line);
+    // Sends `cmd` and blocks until the reader sets `reply`; false if the engine exits or stays
+    // silent for reply_timeout
+    bool sendAndWait(const std::string& cmd, bool& reply);
 
-    int pipe_in[2]; 
-    int pipe_out[2]; 
-    int pid = -1;
-    
-    std::string accumulator;
+    static constexpr std::chrono::seconds reply_timeout{5};
+
+    ChildProcess process;
+    ProcessLimits process_limits;
+    // eventfd that tells the reader to exit
+    int wake_fd = -1;
+
+    // The last `position` command, extended as moves are played
+    std::string position_cmd;
+
+    std::jthread reader;
+    // Handshake replies, guarded by reply_mutex
+    std::mutex reply_mutex;
+    std::condition_variable reply_cv;
+    bool uciok = false;
+    bool readyok = false;
+    bool reader_exited = false;
+
+    struct BestMove {
+        // Which search this answers, counting from 1 since start()
+        uint32_t search = 0;
+        std::string move;
+        std::string ponder;
+    };
+    SpscQueue<BestMove, 16> best_moves;
+    // searches_started is only touched by the caller's thread, searches_answered by the reader
+    uint32_t searches_started = 0;
+    uint32_t searches_answered = 0;
+    std::string ponder_move;
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers, each with its own task deque. A worker runs its newest task first and,
+// once its deque is empty, steals the oldest task of another worker.
+class ThreadPool {
+public:
+	explicit ThreadPool(size_t threads);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t size() const { return workers.size(); }
+
+	// Called from a worker the task goes to that worker's own deque, otherwise round-robin
+	void submit(std::function<void()> task);
+	// Blocks until every submitted task has finished
+	void wait();
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	void workerLoop(size_t index);
+	bool popTask(size_t index, std::function<void()>& task);
+
+	std::vector<Queue> queues;
+	std::vector<std::jthread> workers;
+
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	// Tasks sitting in a deque, and tasks submitted but not yet finished
+	std::atomic<size_t> queued{0};
+	std::atomic<size_t> pending{0};
+	std::atomic<size_t> next_queue{0};
+	bool stopping{false};
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "move.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+enum class Bound : uint8_t { NONE, UPPER, LOWER, EXACT };
+
+struct TTEntry {
+	Move move;
+	int score;
+	int depth;
+	Bound bound;
+};
+
+// Transposition table shared by all search threads. An entry is a single 64-bit word
+// (16-bit key check, move, score, depth, bound and age), read and written with relaxed atomics,
+// so threads never lock and never see half of another thread's write. Four entries make a
+// 32-byte bucket; a store replaces the entry of the same position, or else the one that is
+// shallowest once older searches are discounted.
+class TranspositionTable {
+public:
+	explicit TranspositionTable(size_t megabytes);
+
+	void resize(size_t megabytes);
+	void clear();
+	// Marks entries written from now on as belonging to a new search
+	void newSearch() { age = (age + 1) & age_mask; }
+
+	bool probe(uint64_t key, TTEntry& entry) const;
+	void store(uint64_t key, Move move, int score, int depth, Bound bound);
+
+	size_t megabytes() const { return bucket_count * sizeof(Bucket) / (1024 * 1024); }
+	// Per mille of sampled entries written by the current search, as reported in UCI `hashfull`
+	int hashfull() const;
+
+private:
+	static constexpr int bucket_size{4};
+	static constexpr uint8_t age_mask{0x3F};
+
+	struct alignas(32) Bucket {
+		std::atomic<uint64_t> entries[bucket_size];
+	};
+
+	Bucket& bucketFor(uint64_t key) const;
+
+	std::unique_ptr<Bucket[]> buckets;
+	size_t bucket_count{0};
+	uint8_t age{0};
+};
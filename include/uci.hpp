@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// A move as the engine printed it, kept inline so updates can be queued without allocating
+struct UciMove {
+	std::array<char, 5> text{};
+	uint8_t length{0};
+
+	std::string_view view() const { return {text.data(), length}; }
+};
+
+// One `info` line of a search in progress. Scores are from the side to move's point of view,
+// in centipawns or, for a mate, in moves (negative when being mated).
+struct AnalysisUpdate {
+	static constexpr size_t max_pv{16};
+
+	int depth{0};
+	int seldepth{0};
+	int multipv{1};
+	int score{0};
+	bool mate{false};
+	// Set when the score is only a bound after a fail high or low
+	bool lowerbound{false};
+	bool upperbound{false};
+	uint64_t nodes{0};
+	uint64_t nps{0};
+	uint64_t time_ms{0};
+	// Per mille of the hash table in use
+	int hashfull{0};
+	std::array<UciMove, max_pv> pv{};
+	size_t pv_length{0};
+};
+
+// Parses `info depth ... score ... pv ...` in place, without allocating. Returns false for lines
+// that are not info lines or carry no score (currmove, string, ...), leaving `update` unspecified.
+bool parseInfoLine(std::string_view line, AnalysisUpdate& update);
@@ -1,13 +1,13 @@
 #include "app.hpp"
+#include "builtin_engine.hpp"
+#include "pgn.hpp"
+#include "piece_images.hpp"
+#include "polyglot.hpp"
+#include "result_cache.hpp"
 #include "stockfish.hpp"
 
-// Pieces headers
-#include "pawn.hpp"
-#include "rook.hpp"
-#include "knight.hpp"
-#include "bishop.hpp"
-#include "queen.hpp"
-#include "king.hpp"
+#include "bitboard.hpp"
+#include "position.hpp"
 
 #include <SDL3/SDL.h>
 #include <SDL3_image/SDL_image.h>
@@ -15,74 +15,138 @@
 #include <imgui_impl_sdl3.h>
 #include <imgui_impl_sdlrenderer3.h>
 
+#include <array>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <format>
 #include <print>
+#include <random>
 #include <string>
-#include <unordered_map>
+#include <thread>
+#include <vector>
 #include <algorithm>
 
-char getPieceChar(const std::unique_ptr<Piece>& p) {
-	if (!p)
-		return ' ';
-	char c = '?';
-	switch (p->getType()) {
-	case PieceType::PAWN:
-		c = 'p';
-		break;
-	case PieceType::ROOK:
-		c = 'r';
-		break;
-	case PieceType::KNIGHT:
-		c = 'n';
-		break;
-	case PieceType::BISHOP:
-		c = 'b';
-		break;
-	case PieceType::QUEEN:
-		c = 'q';
-		break;
-	case PieceType::KING:
-		c = 'k';
-		break;
-	default:
-		c = '?';
-		break;
+// Quads cut from the atlas, drawn with one SDL_RenderGeometry call per layer
+struct QuadBatch {
+	std::vector<SDL_Vertex> vertices;
+	std::vector<int> indices;
+
+	void add(const SDL_FRect& dest, const SDL_FRect& uv, SDL_FColor color) {
+		int first = static_cast<int>(vertices.size());
+		vertices.push_back({{dest.x, dest.y}, color, {uv.x, uv.y}});
+		vertices.push_back({{dest.x + dest.w, dest.y}, color, {uv.x + uv.w, uv.y}});
+		vertices.push_back({{dest.x + dest.w, dest.y + dest.h}, color, {uv.x + uv.w, uv.y + uv.h}});
+		vertices.push_back({{dest.x, dest.y + dest.h}, color, {uv.x, uv.y + uv.h}});
+		indices.insert(indices.end(), {first, first + 1, first + 2, first + 2, first + 3, first});
 	}
-	return (p->getColor() == Color::WHITE) ? std::toupper(c) : c;
-}
+};
 
 struct AppState {
 	Stockfish stockfish;
+	BuiltinEngine builtin;
+	// Whichever of the two plays the PvE side
+	Engine* engine = &builtin;
 	bool in_menu = true;
 	bool vs_engine = false;
 	int difficulty = 5;
+	int threads = 1;
+	int hash_mb = 16;
+	// Scheduling of the Stockfish process, so it leaves room for rendering
+	int engine_nice = 0;
+	bool spare_render_cpu = false;
 	Color player_color = Color::WHITE;
-	Color turn = Color::WHITE;
 	BoardCoordinates selected_sq = {-1, -1};
-	std::vector<BoardCoordinates> valid_moves;
-	std::unordered_map<char, SDL_Texture*> textures;
-	bool game_over = false;
+	MoveList valid_moves;
+	// Every piece image in one texture, see atlasCell(); a piece that did not load is drawn as a
+	// plain square. The cell size is that of a board square in pixels, 0 until the first images
+	// are ready.
+	SDL_Texture* atlas = nullptr;
+	int atlas_cell = 0;
+	std::array<bool, no_piece> piece_loaded{};
+	PieceImages piece_images{"piece", "piece-cache"};
+	// Kept between frames so drawing does not allocate
+	QuadBatch batch;
 	std::string status_msg = "Welcome! Choose settings.";
 	bool engine_thinking = false;
-
-	std::vector<std::string> move_history;
 	bool scroll_to_bottom = false;
 
-	BoardCoordinates en_passant_target = {-1, -1};
+	// Analyze mode: the engine searches the board position until stopped, one entry per line
+	bool analyzing = false;
+	int multipv = 1;
+
+	std::array<AnalysisUpdate, 4> analysis_lines{};
+
+	// Small window with the engine's startup and handshake latencies
+	bool show_engine_debug = false;
+	bool show_frame_counter = false;
+	// Frames per second at most, 0 for no limit
+	int frame_cap = 0;
+
+	// PvE answers by position, so a position met again is answered at once
+	ResultCache engine_cache{1 << 16};
+	bool persist_cache = true;
+	// Last main-line score of the running PvE search, stored with its best move
+	AnalysisUpdate engine_score{};
+
+	// Pondering: on the player's turn the engine already searches the reply it expects
+	bool ponder = true;
+	bool pondering = false;
+	std::string ponder_move;
+
+	// Opening moves come from the book while it knows the position
+	PolyglotBook book;
+	bool use_book = true;
+	int book_moves = 12;
+	std::mt19937_64 rng{std::random_device{}()};
 };
 
-AppState g_state;
+// The atlas is a grid of square cells: cell N holds the piece with PieceCode N, and the cell after
+// the last piece is white, for quads that only have a color
+constexpr int atlas_columns{4};
+// Keeps the atlas within the texture size every renderer supports
+constexpr int max_atlas_cell{1024};
+
+// Texture coordinates of a cell, half a texel inside so linear filtering stays in it
+SDL_FRect atlasCell(int cell, int cell_pixels) {
+	float texel{1.0f / static_cast<float>(std::max(cell_pixels, 1) * atlas_columns)};
+	constexpr float cell_size{1.0f / atlas_columns};
+	return {(cell % atlas_columns) * cell_size + texel / 2,
+		(cell / atlas_columns) * cell_size + texel / 2, cell_size - texel, cell_size - texel};
+}
+
+// A single texel from the middle of the white cell
+SDL_FRect atlasSolid(int cell_pixels) {
+	SDL_FRect cell{atlasCell(no_piece, cell_pixels)};
+	return {cell.x + cell.w / 2, cell.y + cell.h / 2, 0, 0};
+}
 
-std::string coordsToString(int x, int y) {
-	char file = 'a' + x;
-	char rank = '8' - y;
-	return std::string{file, rank};
+void pushWake(Uint32 event_type) {
+	SDL_Event e{};
+	e.type = event_type;
+	SDL_PushEvent(&e);
 }
 
+constexpr SDL_FColor rgba(int r, int g, int b, int a = 255) {
+	return {r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f};
+}
+
+// Search limits of an engine move in PvE
+constexpr SearchLimits pve_limits{10, 1000};
+constexpr auto engine_cache_path{"engine-cache.bin"};
+constexpr auto book_path{"book.bin"};
+// Saved games are appended, so one file collects all of them
+constexpr auto games_path{"games.pgn"};
+
+AppState g_state;
+
 App::App() {
 	if (!SDL_Init(App::init_flags))
 		std::exit(EXIT_FAILURE);
 
+	Bitboards::init();
+
 	auto main_scale{SDL_GetDisplayContentScale(SDL_GetPrimaryDisplay())};
 	this->window = SDL_CreateWindow("Chess",
 			App::initial_window_width * static_cast<int32_t>(main_scale),
@@ -100,276 +164,284 @@ App::App() {
 	ImGui_ImplSDL3_InitForSDLRenderer(window, renderer);
 	ImGui_ImplSDLRenderer3_Init(renderer);
 
+	// Engine and rasterizer threads wake the event loop with a user event once they have
+	// something
+	wake_event = SDL_RegisterEvents(1);
+	auto wake = [event_type = wake_event] { pushWake(event_type); };
+	g_state.builtin.setNotify(wake);
+	g_state.stockfish.setNotify(wake);
+
+	// Both are optional: without them the engine searches every position itself
+	if (g_state.persist_cache)
+		g_state.engine_cache.open(engine_cache_path);
+	g_state.book.open(book_path);
+
 	resetBoard();
 }
 
 void App::resetBoard() {
-	for (auto& p : board)
-		p.reset();
-	g_state.turn = Color::WHITE;
-	g_state.game_over = false;
+	game.reset();
 	g_state.selected_sq = {-1, -1};
 	g_state.valid_moves.clear();
 	g_state.engine_thinking = false;
-	g_state.move_history.clear();
-	g_state.en_passant_target = {-1, -1};
+	g_state.pondering = false;
 
 	if (!g_state.in_menu)
-		g_state.status_msg = "White to move";
-
-	auto place = [&](int x, int y, Piece* p) { board[y * 8 + x].reset(p); };
-
-	for (int i = 0; i < 8; i++) {
-		place(i, 1, new Pawn(Color::BLACK, {(int8_t)i, 1}));
-		place(i, 6, new Pawn(Color::WHITE, {(int8_t)i, 6}));
-	}
-	using C = Color;
-	place(0, 0, new Rook(C::BLACK, {0, 0}));
-	place(7, 0, new Rook(C::BLACK, {7, 0}));
-	place(0, 7, new Rook(C::WHITE, {0, 7}));
-	place(7, 7, new Rook(C::WHITE, {7, 7}));
-	place(1, 0, new Knight(C::BLACK, {1, 0}));
-	place(6, 0, new Knight(C::BLACK, {6, 0}));
-	place(1, 7, new Knight(C::WHITE, {1, 7}));
-	place(6, 7, new Knight(C::WHITE, {6, 7}));
-	place(2, 0, new Bishop(C::BLACK, {2, 0}));
-	place(5, 0, new Bishop(C::BLACK, {5, 0}));
-	place(2, 7, new Bishop(C::WHITE, {2, 7}));
-	place(5, 7, new Bishop(C::WHITE, {5, 7}));
-	place(3, 0, new Queen(C::BLACK, {3, 0}));
-	place(4, 0, new King(C::BLACK, {4, 0}));
-	place(3, 7, new Queen(C::WHITE, {3, 7}));
-	place(4, 7, new King(C::WHITE, {4, 7}));
+		g_state.status_msg = game.status();
 }
 
-void App::loadTextures() {
-	const char* pieces = "prnbqk";
-	const char* colors = "wb";
-	for (int c = 0; c < 2; c++) {
-		for (int p = 0; p < 6; p++) {
-			std::string filename = "piece/";
-			filename += colors[c];
-			filename += (char)std::toupper(pieces[p]);
-			filename += ".svg";
-			SDL_Surface* surf = nullptr;
-			SDL_IOStream* io = SDL_IOFromFile(filename.c_str(), "rb");
-			if (io) {
-				surf = IMG_LoadSizedSVG_IO(io, 256, 256);
-				SDL_CloseIO(io);
-			}
-			if (!surf)
-				surf = IMG_Load(filename.c_str());
-			if (surf) {
-				SDL_Texture* tex = SDL_CreateTextureFromSurface(renderer, surf);
-				SDL_SetTextureScaleMode(tex, SDL_SCALEMODE_LINEAR);
-				g_state.textures[(c == 0) ? std::toupper(pieces[p]) : pieces[p]] = tex;
-				SDL_DestroySurface(surf);
-			}
-		}
+void App::updatePieceImages() {
+	if (auto images = g_state.piece_images.takeFinished()) {
+		frame_stats.piece_size = images->size;
+		frame_stats.piece_ms = images->time_ms;
+		frame_stats.piece_cache_hits = images->cache_hits;
+		buildAtlas(*images);
+		invalidate();
 	}
+
+	// Pieces are rasterized at the size they are drawn, so they are never scaled on screen
+	int size{std::clamp(static_cast<int>(squareSize()), 1, max_atlas_cell)};
+	// While resizing, the next size is only requested after the previous one is done
+	if (size != g_state.atlas_cell && !g_state.piece_images.busy())
+		g_state.piece_images.request(size, [event_type = wake_event] { pushWake(event_type); });
 }
 
-// Generate FEN with proper Castling & En Passant
-std::string generateFEN(const std::array<std::unique_ptr<Piece>, 64>& board, Color turn) {
-	std::string fen = "";
-	for (int y = 0; y < 8; y++) {
-		int empty = 0;
-		for (int x = 0; x < 8; x++) {
-			auto& p = board[y * 8 + x];
-			if (!p)
-				empty++;
-			else {
-				if (empty > 0) {
-					fen += std::to_string(empty);
-					empty = 0;
-				}
-				fen += getPieceChar(p);
-			}
+void App::buildAtlas(const PieceBitmaps& images) {
+	int cell{images.size};
+	int atlas_size{cell * atlas_columns};
+	size_t atlas_row{static_cast<size_t>(atlas_size) * 4};
+	size_t cell_row{static_cast<size_t>(cell) * 4};
+	// Pixels start out transparent
+	std::vector<uint8_t> pixels(atlas_row * static_cast<size_t>(atlas_size), 0);
+	auto cellStart = [&](int index) {
+		return pixels.data() + atlas_row * static_cast<size_t>(index / atlas_columns * cell) +
+		       cell_row * static_cast<size_t>(index % atlas_columns);
+	};
+	for (int y = 0; y < cell; y++)
+		std::memset(cellStart(no_piece) + atlas_row * static_cast<size_t>(y), 0xFF, cell_row);
+	for (PieceCode piece = 0; piece < no_piece; piece++) {
+		const std::vector<uint8_t>& image = images.pixels[piece];
+		g_state.piece_loaded[piece] = !image.empty();
+		for (int y = 0; y < cell && !image.empty(); y++) {
+			std::memcpy(cellStart(piece) + atlas_row * static_cast<size_t>(y),
+					image.data() + cell_row * static_cast<size_t>(y), cell_row);
 		}
-		if (empty > 0)
-			fen += std::to_string(empty);
-		if (y < 7)
-			fen += "/";
-	}
-	fen += (turn == Color::WHITE ? " w " : " b ");
-
-	std::string castling = "";
-	auto& wk = board[60];
-	if (wk && wk->getType() == PieceType::KING && !wk->hasMoved()) {
-		auto& wrk = board[63];
-		if (wrk && wrk->getType() == PieceType::ROOK && !wrk->hasMoved())
-			castling += "K";
-		auto& wrq = board[56];
-		if (wrq && wrq->getType() == PieceType::ROOK && !wrq->hasMoved())
-			castling += "Q";
-	}
-	auto& bk = board[4];
-	if (bk && bk->getType() == PieceType::KING && !bk->hasMoved()) {
-		auto& brk = board[7];
-		if (brk && brk->getType() == PieceType::ROOK && !brk->hasMoved())
-			castling += "k";
-		auto& brq = board[0];
-		if (brq && brq->getType() == PieceType::ROOK && !brq->hasMoved())
-			castling += "q";
-	}
-	if (castling.empty())
-		castling = "-";
-	fen += " " + castling;
-
-	if (g_state.en_passant_target.x != -1) {
-		fen += " " + coordsToString(g_state.en_passant_target.x, g_state.en_passant_target.y);
-	} else {
-		fen += " -";
 	}
 
-	fen += " 0 1";
-	return fen;
+	SDL_DestroyTexture(g_state.atlas);
+	g_state.atlas_cell = cell;
+	g_state.atlas = SDL_CreateTexture(
+			renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, atlas_size, atlas_size);
+	if (!g_state.atlas || !SDL_UpdateTexture(g_state.atlas, nullptr, pixels.data(),
+					      static_cast<int>(atlas_row))) {
+		std::println(stderr, "could not upload the texture atlas: {}", SDL_GetError());
+		SDL_DestroyTexture(g_state.atlas);
+		g_state.atlas = nullptr;
+		g_state.piece_loaded = {};
+		return;
+	}
+	SDL_SetTextureScaleMode(g_state.atlas, SDL_SCALEMODE_LINEAR);
+	SDL_SetTextureBlendMode(g_state.atlas, SDL_BLENDMODE_BLEND);
 }
 
-bool isSquareAttacked(const std::array<std::unique_ptr<Piece>, 64>& board, BoardCoordinates sq,
-		Color defenderColor) {
-	for (const auto& p : board) {
-		if (p && p->getColor() != defenderColor) {
-			auto moves = p->getPossibleMoves(board);
-			for (const auto& m : moves) {
-				if (m.x == sq.x && m.y == sq.y)
-					return true;
-			}
-		}
+void App::drawBatch() {
+	QuadBatch& batch = g_state.batch;
+	if (!batch.vertices.empty()) {
+		SDL_RenderGeometry(renderer, g_state.atlas, batch.vertices.data(),
+				static_cast<int>(batch.vertices.size()), batch.indices.data(),
+				static_cast<int>(batch.indices.size()));
+		frame_stats.board_draw_calls++;
 	}
-	return false;
+	batch.vertices.clear();
+	batch.indices.clear();
 }
 
-bool isKingInCheck(const std::array<std::unique_ptr<Piece>, 64>& board, Color kingColor) {
-	BoardCoordinates kingPos = {-1, -1};
-	for (const auto& p : board) {
-		if (p && p->getType() == PieceType::KING && p->getColor() == kingColor) {
-			kingPos = p->getPosition();
-			break;
-		}
+// The process and its handshake survive between games; only the options are sent again
+bool startEngine() {
+	// Only the external engine runs in its own process
+	ProcessLimits limits;
+	limits.nice = g_state.engine_nice;
+	int cpus = static_cast<int>(std::thread::hardware_concurrency());
+	if (g_state.spare_render_cpu && cpus > 1) {
+		for (int cpu = 1; cpu < cpus; cpu++)
+			limits.cpus.push_back(cpu);
 	}
-	if (kingPos.x == -1)
+	g_state.stockfish.setProcessLimits(limits);
+
+	if (!g_state.engine->start()) {
+		g_state.status_msg = "Engine failed to start";
 		return false;
-	return isSquareAttacked(board, kingPos, kingColor);
+	}
+	g_state.engine->setSkillLevel(g_state.difficulty);
+	g_state.engine->setThreads(g_state.threads);
+	g_state.engine->setHashSize(g_state.hash_mb);
+	return true;
 }
 
-bool isMoveSafe(
-		std::array<std::unique_ptr<Piece>, 64>& board, int from_idx, int to_idx, Color turn) {
-	bool is_ep = false;
-	int ep_capture_idx = -1;
-	if (board[from_idx]->getType() == PieceType::PAWN && to_idx % 8 != from_idx % 8 &&
-			board[to_idx] == nullptr) {
-		is_ep = true;
-		ep_capture_idx = (from_idx / 8) * 8 + (to_idx % 8);
+// Restarts the infinite search on the current position; stops it once the game is over
+void updateAnalysis(const Game& game) {
+	if (!g_state.analyzing)
+		return;
+	g_state.analysis_lines = {};
+	g_state.engine->stopSearch();
+	if (game.isOver()) {
+		g_state.analyzing = false;
+		return;
 	}
+	g_state.engine->setMultiPV(g_state.multipv);
+	g_state.engine->setPosition(game.startFen(), game.moves());
+	g_state.engine->goInfinite();
+}
 
-	std::unique_ptr<Piece> captured_piece;
-	if (is_ep) {
-		captured_piece = std::move(board[ep_capture_idx]);
-		board[ep_capture_idx] = nullptr;
-	} else {
-		captured_piece = std::move(board[to_idx]);
-	}
+// Pondering runs on the player's time, until their move or the end of the game
+void stopPondering() {
+	if (!g_state.pondering)
+		return;
+	g_state.pondering = false;
+	g_state.engine->stopSearch();
+}
 
-	board[to_idx] = std::move(board[from_idx]);
-	BoardCoordinates old_pos = board[to_idx]->getPosition();
-	BoardCoordinates new_pos = {(int8_t)(to_idx % 8), (int8_t)(to_idx / 8)};
-	board[to_idx]->setPosition(new_pos);
+void playMove(Game& game, Move m) {
+	if (!game.play(m))
+		return;
+	g_state.scroll_to_bottom = true;
+	g_state.status_msg = game.status();
+	if (game.isOver())
+		stopPondering();
+	updateAnalysis(game);
+}
 
-	bool safe = !isKingInCheck(board, turn);
+// Searches the player's expected reply on the player's time
+void startPondering(const Game& game, const std::string& reply) {
+	if (!g_state.ponder || game.isOver() || reply.empty())
+		return;
+	if (!game.isLegal(game.position().parseMove(reply)))
+		return;
+	std::vector<std::string> moves = game.moves();
+	moves.push_back(reply);
+	g_state.engine->setPosition(game.startFen(), moves);
+	g_state.engine->goPonder(pve_limits.depth, pve_limits.movetime_ms);
+	g_state.pondering = true;
+	g_state.ponder_move = reply;
+}
 
-	board[to_idx]->setPosition(old_pos);
-	board[from_idx] = std::move(board[to_idx]);
+// Book replies are picked at random by weight, so games against the engine vary
+bool playBookMove(Game& game) {
+	if (!g_state.use_book)
+		return false;
+	g_state.book.setMaxMoves(g_state.book_moves);
+	Move m = g_state.book.pick(game.position(), g_state.rng);
+	if (m == Move::none())
+		return false;
+	playMove(game, m);
+	return true;
+}
 
-	if (is_ep)
-		board[ep_capture_idx] = std::move(captured_piece);
-	else
-		board[to_idx] = std::move(captured_piece);
+// Skill and engine change the answer as much as the limits do
+uint32_t cacheVariant() {
+	uint32_t engine = g_state.engine == &g_state.stockfish ? 1 : 0;
+	return engine << 8 | static_cast<uint32_t>(g_state.difficulty);
+}
 
-	return safe;
+// Plays the remembered answer for this position; false when there is none, or it is not legal
+// here because two positions share a key
+bool playCachedMove(Game& game) {
+	CachedResult cached;
+	if (!g_state.engine_cache.lookup(game.position().key(), pve_limits, cacheVariant(), cached))
+		return false;
+	Move m = game.position().parseMove(cached.best_move.view());
+	if (!game.isLegal(m))
+		return false;
+	playMove(game, m);
+	return true;
 }
 
-void checkGameState(std::array<std::unique_ptr<Piece>, 64>& board) {
-	bool in_check = isKingInCheck(board, g_state.turn);
-	bool has_legal_moves = false;
-	for (int i = 0; i < 64; ++i) {
-		if (board[i] && board[i]->getColor() == g_state.turn) {
-			auto moves = board[i]->getPossibleMoves(board);
-			// Add EP moves to check
-			if (board[i]->getType() == PieceType::PAWN && g_state.en_passant_target.x != -1) {
-				int dir = (g_state.turn == Color::WHITE) ? -1 : 1;
-				int py = board[i]->getPosition().y;
-				int px = board[i]->getPosition().x;
-				if (std::abs(g_state.en_passant_target.x - px) == 1 &&
-						g_state.en_passant_target.y == py + dir) {
-					moves.push_back(g_state.en_passant_target);
-				}
-			}
+void takeBack(Game& game) {
+	stopPondering();
+	game.takeBack();
+	g_state.status_msg = game.status();
+	updateAnalysis(game);
+}
 
-			for (auto& m : moves) {
-				int to_idx = m.y * 8 + m.x;
-				if (isMoveSafe(board, i, to_idx, g_state.turn)) {
-					has_legal_moves = true;
-					break;
-				}
-			}
-		}
-		if (has_legal_moves)
-			break;
-	}
-	if (!has_legal_moves) {
-		g_state.game_over = true;
-		g_state.status_msg = in_check ? "Checkmate!" : "Stalemate!";
-	} else {
-		g_state.status_msg = in_check ?
-				"Check!" :
-				(g_state.turn == Color::WHITE ? "White to move" : "Black to move");
+// A game still going on is saved with the result "*"
+bool saveGame(const Game& game) {
+	std::time_t now = std::time(nullptr);
+	char date[16];
+	std::strftime(date, sizeof(date), "%Y.%m.%d", std::localtime(&now));
+
+	PgnHeaders headers;
+	headers.event = g_state.vs_engine ? "PvE" : "PvP";
+	headers.date = date;
+	headers.white = "White";
+	headers.black = "Black";
+	if (g_state.vs_engine) {
+		std::string engine = std::format("{} (skill {})",
+				g_state.engine == &g_state.stockfish ? "Stockfish" : "Built-in",
+				g_state.difficulty);
+		bool white = g_state.player_color == Color::WHITE;
+		headers.white = white ? "Player" : engine;
+		headers.black = white ? engine : "Player";
 	}
+	std::string pgn;
+	writePgn(pgn, game, headers);
+
+	FILE* file = std::fopen(games_path, "a");
+	if (!file)
+		return false;
+	bool ok = std::fwrite(pgn.data(), 1, pgn.size(), file) == pgn.size();
+	return std::fclose(file) == 0 && ok;
 }
 
 void App::run() {
-	loadTextures();
 	auto done{false};
 	SDL_Event event{};
+	// With a frame cap, the earliest time the next frame may be drawn
+	Uint64 next_frame{0};
 
 	while (!done) {
+		// Sleep until input or an engine answer arrives; with a frame waiting to be drawn, only
+		// until it is due. The event stays queued for the loop below.
+		Sint32 timeout{idle_wait_ms};
+		if (dirty_frames > 0) {
+			Uint64 now{SDL_GetTicksNS()};
+			timeout = next_frame > now ?
+					static_cast<Sint32>((next_frame - now + SDL_NS_PER_MS - 1) / SDL_NS_PER_MS) :
+					0;
+		}
+		SDL_WaitEventTimeout(nullptr, timeout);
+
 		while (SDL_PollEvent(&event)) {
 			ImGui_ImplSDL3_ProcessEvent(&event);
+			// Wake-ups only matter if what they bring changes the screen, checked below
+			if (event.type != wake_event)
+				invalidate();
 			if (event.type == SDL_EVENT_QUIT)
 				done = true;
 			if (event.type == SDL_EVENT_WINDOW_CLOSE_REQUESTED &&
 					event.window.windowID == SDL_GetWindowID(window))
 				done = true;
-			if (g_state.in_menu || g_state.game_over)
+			if (g_state.in_menu || game.isOver())
 				continue;
 
 			if (!ImGui::GetIO().WantCaptureMouse && event.type == SDL_EVENT_MOUSE_BUTTON_DOWN) {
 				if (g_state.vs_engine && g_state.engine_thinking)
 					continue;
-				int w, h;
-				SDL_GetWindowSize(window, &w, &h);
-				float board_dim = std::min(w, h);
-				float sq_size = board_dim / 8.0f;
+				// Clicks arrive in window points, the board is drawn in render pixels
+				SDL_ConvertEventToRenderCoordinates(renderer, &event);
+				float sq_size = squareSize();
 				int bx = static_cast<int>(event.button.x / sq_size);
 				int by = static_cast<int>(event.button.y / sq_size);
 
 				if (bx >= 0 && bx < 8 && by >= 0 && by < 8) {
 					if (g_state.selected_sq.x == -1) {
 						int idx = by * 8 + bx;
-						if (board[idx] && board[idx]->getColor() == g_state.turn) {
-							if (g_state.vs_engine && g_state.turn != g_state.player_color)
+						const Position& board = game.position();
+						Color turn = board.sideToMove();
+						if (!board.isEmpty(idx) && colorOf(board.pieceAt(idx)) == turn) {
+							if (g_state.vs_engine && turn != g_state.player_color)
 								continue;
 							g_state.selected_sq = {(int8_t)bx, (int8_t)by};
-							g_state.valid_moves = board[idx]->getPossibleMoves(board);
-
-							if (board[idx]->getType() == PieceType::PAWN &&
-									g_state.en_passant_target.x != -1) {
-								int dir = (g_state.turn == Color::WHITE) ? -1 : 1;
-								if (std::abs(g_state.en_passant_target.x - bx) == 1 &&
-										g_state.en_passant_target.y == by + dir) {
-									g_state.valid_moves.push_back(g_state.en_passant_target);
-								}
-							}
+							game.legalMovesFrom(idx, g_state.valid_moves);
 						}
 					} else {
 						if (bx == g_state.selected_sq.x && by == g_state.selected_sq.y) {
@@ -377,73 +449,10 @@ void App::run() {
 							g_state.valid_moves.clear();
 							continue;
 						}
-						for (auto& m : g_state.valid_moves) {
-							if (m.x == bx && m.y == by) {
-								int from_idx = g_state.selected_sq.y * 8 + g_state.selected_sq.x;
-								int to_idx = by * 8 + bx;
-
-								bool is_castling = false;
-								if (board[from_idx]->getType() == PieceType::KING &&
-										std::abs(bx - g_state.selected_sq.x) > 1) {
-									int step = (bx > g_state.selected_sq.x) ? 1 : -1;
-									int mid_x = g_state.selected_sq.x + step;
-									BoardCoordinates mid_sq = {(int8_t)mid_x, (int8_t)by};
-									if (isKingInCheck(board, g_state.turn) ||
-											isSquareAttacked(board, mid_sq, g_state.turn)) {
-										std::println("Illegal Castle!");
-										break;
-									}
-									is_castling = true;
-								}
-
-								if (isMoveSafe(board, from_idx, to_idx, g_state.turn)) {
-									std::string move_str = coordsToString(g_state.selected_sq.x,
-																   g_state.selected_sq.y) +
-											coordsToString(bx, by);
-									g_state.move_history.push_back(move_str);
-									g_state.scroll_to_bottom = true;
-
-									BoardCoordinates next_ep_target = {-1, -1};
-									if (board[from_idx]->getType() == PieceType::PAWN &&
-											std::abs(by - g_state.selected_sq.y) == 2) {
-										next_ep_target = {
-											(int8_t)bx, (int8_t)((g_state.selected_sq.y + by) / 2)};
-									}
-
-									if (board[from_idx]->getType() == PieceType::PAWN &&
-											bx == g_state.en_passant_target.x &&
-											by == g_state.en_passant_target.y) {
-										int capture_idx = g_state.selected_sq.y * 8 + bx;
-										board[capture_idx] = nullptr;
-									}
-
-									board[to_idx] = std::move(board[from_idx]);
-									board[to_idx]->setPosition({(int8_t)bx, (int8_t)by});
-									board[from_idx] = nullptr;
-
-									// --- PLAYER PROMOTION ---
-									if (board[to_idx]->getType() == PieceType::PAWN &&
-											(by == 0 || by == 7)) {
-										// Auto-promote to Queen
-										board[to_idx] = std::make_unique<Queen>(
-												g_state.turn, board[to_idx]->getPosition());
-									}
-
-									if (is_castling) {
-										int r_from_x = (bx > g_state.selected_sq.x) ? 7 : 0;
-										int r_to_x = (bx > g_state.selected_sq.x) ? 5 : 3;
-										int r_from_idx = by * 8 + r_from_x;
-										int r_to_idx = by * 8 + r_to_x;
-										board[r_to_idx] = std::move(board[r_from_idx]);
-										board[r_to_idx]->setPosition({(int8_t)r_to_x, (int8_t)by});
-										board[r_from_idx] = nullptr;
-									}
-
-									g_state.en_passant_target = next_ep_target;
-									g_state.turn = (g_state.turn == Color::WHITE) ? Color::BLACK :
-																					Color::WHITE;
-									checkGameState(board);
-								}
+						// Promotions come queen first, so the first match auto-promotes to a queen
+						for (Move m : g_state.valid_moves) {
+							if (m.to() == by * 8 + bx) {
+								playMove(game, m);
 								break;
 							}
 						}
@@ -454,90 +463,85 @@ void App::run() {
 			}
 		}
 
-		if (!g_state.in_menu && !g_state.game_over && g_state.vs_engine &&
+		if (!g_state.in_menu && !game.isOver() && g_state.vs_engine &&
 				!g_state.engine_thinking) {
-			if (g_state.turn != g_state.player_color) {
-				g_state.engine_thinking = true;
-				std::string fen = generateFEN(board, g_state.turn);
-				g_state.stockfish.setPosition(fen);
-				g_state.stockfish.go(10, 1000);
+			if (game.sideToMove() != g_state.player_color) {
+				if (g_state.pondering && game.moves().back() == g_state.ponder_move) {
+					// The search already running is on this very position
+					g_state.pondering = false;
+					g_state.engine_thinking = true;
+					g_state.engine_score = {};
+					g_state.engine->ponderHit();
+				} else {
+					stopPondering();
+					if (!playBookMove(game) && !playCachedMove(game)) {
+						g_state.engine_thinking = true;
+						g_state.engine_score = {};
+						g_state.engine->setPosition(game.startFen(), game.moves());
+						g_state.engine->go(pve_limits.depth, pve_limits.movetime_ms);
+					}
+				}
 			}
 		}
 
+		// Pondering reports too; drain it so the queue does not fill before the hit
+		if (g_state.vs_engine && (g_state.engine_thinking || g_state.pondering)) {
+			AnalysisUpdate update;
+			while (g_state.engine->getAnalysis(update)) {
+				if (update.multipv == 1)
+					g_state.engine_score = update;
+			}
+		}
 		if (g_state.vs_engine && g_state.engine_thinking) {
-			auto move = g_state.stockfish.getBestMove();
+			auto move = g_state.engine->getBestMove();
 			if (move) {
 				std::string m = *move;
-				std::println("DEBUG: Engine moved: {}", m);
-				g_state.move_history.push_back(m);
-				g_state.scroll_to_bottom = true;
-
-				int fx = m[0] - 'a';
-				int fy = 8 - (m[1] - '0');
-				int tx = m[2] - 'a';
-				int ty = 8 - (m[3] - '0');
-				int from = fy * 8 + fx;
-				int to = ty * 8 + tx;
-
-				if (from >= 0 && from < 64 && to >= 0 && to < 64 && board[from]) {
-					if (board[from]->getType() == PieceType::KING && std::abs(tx - fx) > 1) {
-						int r_from_x = (tx > fx) ? 7 : 0;
-						int r_to_x = (tx > fx) ? 5 : 3;
-						int r_from_idx = fy * 8 + r_from_x;
-						int r_to_idx = fy * 8 + r_to_x;
-						board[r_to_idx] = std::move(board[r_from_idx]);
-						board[r_to_idx]->setPosition({(int8_t)r_to_x, (int8_t)fy});
-						board[r_from_idx] = nullptr;
-					}
-
-					BoardCoordinates next_ep_target = {-1, -1};
-					if (board[from]->getType() == PieceType::PAWN && std::abs(ty - fy) == 2) {
-						next_ep_target = {(int8_t)tx, (int8_t)((fy + ty) / 2)};
-					}
-
-					if (board[from]->getType() == PieceType::PAWN && tx != fx &&
-							board[to] == nullptr) {
-						int capture_idx = fy * 8 + tx;
-						board[capture_idx] = nullptr;
-					}
-
-					board[to] = std::move(board[from]);
-					board[to]->setPosition({(int8_t)tx, (int8_t)ty});
-					board[from] = nullptr;
-
-					// --- ENGINE PROMOTION ---
-					if (m.length() == 5) {
-						char promo = m[4];
-						Color c = board[to]->getColor();
-						BoardCoordinates pos = board[to]->getPosition();
-						switch (promo) {
-						case 'q':
-							board[to] = std::make_unique<Queen>(c, pos);
-							break;
-						case 'r':
-							board[to] = std::make_unique<Rook>(c, pos);
-							break;
-						case 'b':
-							board[to] = std::make_unique<Bishop>(c, pos);
-							break;
-						case 'n':
-							board[to] = std::make_unique<Knight>(c, pos);
-							break;
-						default:
-							break;
-						}
-					}
-
-					g_state.en_passant_target = next_ep_target;
-					g_state.turn = g_state.player_color;
-					checkGameState(board);
+				Move engine_move = game.position().parseMove(m);
+				if (game.isLegal(engine_move)) {
+					CachedResult result;
+					result.best_move.length = static_cast<uint8_t>(
+							m.copy(result.best_move.text.data(),
+									result.best_move.text.size()));
+					result.score = g_state.engine_score.score;
+					result.mate = g_state.engine_score.mate;
+					result.depth = g_state.engine_score.depth;
+					g_state.engine_cache.store(game.position().key(), pve_limits,
+							cacheVariant(), result);
+					playMove(game, engine_move);
+					startPondering(game, g_state.engine->getPonderMove());
 				} else {
-					g_state.turn = g_state.player_color;
+					// Searching the same position again would only bring the same answer; the
+					// player keeps the board and moves for both sides from here
+					g_state.vs_engine = false;
+					g_state.status_msg = std::format(
+							"Engine answered {}, which is not a legal move; engine game stopped",
+							m);
 				}
 				g_state.engine_thinking = false;
+				invalidate();
 			}
 		}
 
+		if (g_state.analyzing) {
+			AnalysisUpdate update;
+			while (g_state.engine->getAnalysis(update)) {
+				if (update.multipv >= 1 &&
+						update.multipv <= static_cast<int>(g_state.analysis_lines.size())) {
+					g_state.analysis_lines[update.multipv - 1] = update;
+					invalidate();
+				}
+			}
+		}
+
+		updatePieceImages();
+
+		// A capped frame rate draws at most once per interval, the latest state included
+		if (dirty_frames == 0 || SDL_GetTicksNS() < next_frame) {
+			frames_skipped++;
+			continue;
+		}
+
+		Uint64 frame_start{SDL_GetTicksNS()};
 		ImGui_ImplSDLRenderer3_NewFrame();
 		ImGui_ImplSDL3_NewFrame();
 		ImGui::NewFrame();
@@ -566,6 +570,13 @@ void App::run() {
 			ImGui::SameLine();
 			ImGui::RadioButton("PvE", &mode, 1);
 
+			static int engine_choice = 0;
+			ImGui::Text("Engine:");
+			ImGui::SameLine();
+			ImGui::RadioButton("Built-in", &engine_choice, 0);
+			ImGui::SameLine();
+			ImGui::RadioButton("Stockfish", &engine_choice, 1);
+
 			static int color_choice = 0;
 			ImGui::Text("Color:");
 			ImGui::SameLine();
@@ -574,16 +585,45 @@ void App::run() {
 			ImGui::RadioButton("Black", &color_choice, 1);
 
 			ImGui::SliderInt("Difficulty", &g_state.difficulty, 0, 20);
+			static const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+			ImGui::SliderInt("Threads", &g_state.threads, 1, max_threads);
+			ImGui::SliderInt("Hash (MB)", &g_state.hash_mb, 1, 1024);
+			if (engine_choice == 1) {
+				ImGui::SliderInt("Engine nice", &g_state.engine_nice, 0, 19);
+				ImGui::Checkbox("Leave CPU 0 to the GUI", &g_state.spare_render_cpu);
+			}
+			ImGui::SliderInt("Frame cap", &g_state.frame_cap, 0, 240,
+					g_state.frame_cap == 0 ? "off" : "%d fps");
+			// Off, the file is neither read nor written; answers of this session stay in memory
+			if (ImGui::Checkbox("Keep engine answers on disk", &g_state.persist_cache)) {
+				if (g_state.persist_cache)
+					g_state.engine_cache.open(engine_cache_path);
+				else
+					g_state.engine_cache.close();
+			}
+			ImGui::Checkbox("Ponder on my time", &g_state.ponder);
+			if (g_state.book.isOpen()) {
+				ImGui::Checkbox("Opening book", &g_state.use_book);
+				ImGui::SliderInt("Book moves", &g_state.book_moves, 1, 40);
+			}
 
 			if (ImGui::Button("START", ImVec2(-1, 80))) {
 				g_state.vs_engine = (mode == 1);
 				g_state.player_color = (color_choice == 0) ? Color::WHITE : Color::BLACK;
 				resetBoard();
+				Engine* chosen = engine_choice == 0 ? static_cast<Engine*>(&g_state.builtin) :
+								      static_cast<Engine*>(&g_state.stockfish);
+				// Keep the running engine for the next game unless another one was picked
+				if (chosen != g_state.engine)
+					g_state.engine->stop();
+				g_state.engine = chosen;
+				// In PvP the engine is only started for analysis
 				if (g_state.vs_engine) {
-					g_state.stockfish.start();
-					g_state.stockfish.setSkillLevel(g_state.difficulty);
-				} else
-					g_state.stockfish.stop();
+					if (startEngine())
+						g_state.engine->newGame();
+					else
+						g_state.vs_engine = false;
+				}
 				g_state.in_menu = false;
 			}
 			ImGui::End();
@@ -596,33 +636,149 @@ void App::run() {
 			ImGui::TextWrapped("%s", g_state.status_msg.c_str());
 			if (ImGui::Button("MENU", ImVec2(-1, 50))) {
 				g_state.in_menu = true;
-				g_state.stockfish.stop();
+				g_state.analyzing = false;
+				g_state.pondering = false;
+				g_state.engine->stopSearch();
+			}
+			// Against the engine, take back until it is the player's turn again
+			bool can_take_back = game.ply() > 0 && !g_state.engine_thinking;
+			if (can_take_back && ImGui::Button("TAKE BACK", ImVec2(-1, 50))) {
+				takeBack(game);
+				while (g_state.vs_engine && game.sideToMove() != g_state.player_color &&
+						game.ply() > 0)
+					takeBack(game);
+				g_state.selected_sq = {-1, -1};
+				g_state.valid_moves.clear();
+			}
+			if (game.ply() > 0 && ImGui::Button("SAVE PGN", ImVec2(-1, 50))) {
+				g_state.status_msg = saveGame(game) ? std::format("Saved to {}", games_path) :
+								      std::format("Cannot write {}", games_path);
+			}
+
+			// Analysis shares the engine, so it is only offered when the engine is not playing
+			if (!g_state.vs_engine && !game.isOver()) {
+				const char* label = g_state.analyzing ? "STOP ANALYSIS" : "ANALYZE";
+				if (ImGui::Button(label, ImVec2(-1, 50))) {
+					if (g_state.analyzing) {
+						g_state.analyzing = false;
+						g_state.engine->stopSearch();
+					} else if (startEngine()) {
+						g_state.analyzing = true;
+						updateAnalysis(game);
+					}
+				}
+				// The builtin engine only has its main line to show
+				int max_lines = std::min(static_cast<int>(g_state.analysis_lines.size()),
+						g_state.engine->maxMultiPV());
+				g_state.multipv = std::min(g_state.multipv, max_lines);
+				if (max_lines > 1 && ImGui::SliderInt("Lines", &g_state.multipv, 1, max_lines))
+					updateAnalysis(game);
+			}
+			if (g_state.analyzing) {
+				// Engines score from the side to move; show it from white's side
+				int sign = game.sideToMove() == Color::WHITE ? 1 : -1;
+				for (int i = 0; i < g_state.multipv; i++) {
+					const AnalysisUpdate& line = g_state.analysis_lines[i];
+					if (line.depth == 0)
+						continue;
+					if (line.mate)
+						ImGui::Text("#%d", sign * line.score);
+					else
+						ImGui::Text("%+.2f", sign * line.score / 100.0);
+					ImGui::SameLine();
+					ImGui::Text("depth %d  %llu kn/s", line.depth,
+							static_cast<unsigned long long>(line.nps / 1000));
+					std::string pv;
+					for (size_t j = 0; j < line.pv_length; j++) {
+						pv += line.pv[j].view();
+						pv += ' ';
+					}
+					ImGui::TextWrapped("%s", pv.c_str());
+				}
 			}
 
 			ImGui::Separator();
 			ImGui::BeginChild("History", ImVec2(0, 200), true);
-			for (size_t i = 0; i < g_state.move_history.size(); ++i) {
+			const std::vector<std::string>& history = game.moves();
+			for (size_t i = 0; i < history.size(); ++i) {
 				if (i % 2 == 0)
-					ImGui::Text("%d. %s", (int)(i / 2 + 1), g_state.move_history[i].c_str());
+					ImGui::Text("%d. %s", (int)(i / 2 + 1), history[i].c_str());
 				else {
 					ImGui::SameLine();
-					ImGui::Text("%s", g_state.move_history[i].c_str());
+					ImGui::Text("%s", history[i].c_str());
 				}
 			}
 			if (g_state.scroll_to_bottom)
 				ImGui::SetScrollHereY(1.0f);
 			g_state.scroll_to_bottom = false;
 			ImGui::EndChild();
+			ImGui::Checkbox("Engine debug", &g_state.show_engine_debug);
+			ImGui::Checkbox("Frame counter", &g_state.show_frame_counter);
+			ImGui::End();
+
+			if (g_state.show_engine_debug) {
+				const EngineTimings& t = g_state.engine->timings();
+				ImGui::SetNextWindowPos(
+						ImVec2(win_w - 10.0f, 10.0f), ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+				ImGui::SetNextWindowBgAlpha(0.6f);
+				ImGui::Begin("Engine debug", nullptr,
+						ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+								ImGuiWindowFlags_NoInputs |
+								ImGuiWindowFlags_NoFocusOnAppearing);
+				ImGui::Text("spawn       %7.1f ms", t.spawn_ms);
+				ImGui::Text("uciok       %7.1f ms", t.uciok_ms);
+				ImGui::Text("readyok     %7.1f ms", t.readyok_ms);
+				ImGui::Text("ucinewgame  %7.1f ms", t.newgame_ms);
+				ImGui::Text("cache       %zu, %llu hits, %llu misses",
+						g_state.engine_cache.size(),
+						static_cast<unsigned long long>(g_state.engine_cache.hits()),
+						static_cast<unsigned long long>(g_state.engine_cache.misses()));
+				ImGui::Text("book        %zu entries", g_state.book.size());
+				ImGui::Text("hash        %d per mille full", g_state.engine_score.hashfull);
+				ImGui::End();
+			}
+		}
+
+		if (g_state.show_frame_counter) {
+			ImGui::SetNextWindowPos(
+					ImVec2(10.0f, win_h - 10.0f), ImGuiCond_Always, ImVec2(0.0f, 1.0f));
+			ImGui::SetNextWindowBgAlpha(0.6f);
+			ImGui::Begin("Frame counter", nullptr,
+					ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+							ImGuiWindowFlags_NoInputs | ImGuiWindowFlags_NoFocusOnAppearing);
+			ImGui::Text("rendered %llu", static_cast<unsigned long long>(frames_rendered + 1));
+			ImGui::Text("skipped  %llu", static_cast<unsigned long long>(frames_skipped));
+			// Counts of the previous frame, this one is still being built
+			ImGui::Text("draw calls %d board + %d UI", frame_stats.board_draw_calls,
+					frame_stats.ui_draw_calls);
+			ImGui::Text("frame    %.2f ms", frame_stats.frame_ms);
+			ImGui::Text("pieces   %d px, %.1f ms, %d cached", frame_stats.piece_size,
+					frame_stats.piece_ms, frame_stats.piece_cache_hits);
 			ImGui::End();
 		}
 
 		SDL_SetRenderDrawColor(renderer, 30, 30, 30, 255);
 		SDL_RenderClear(renderer);
+		frame_stats.board_draw_calls = 0;
 		drawBoardBackground();
 		renderBoard();
 		ImGui::Render();
-		ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), renderer);
+		ImDrawData* draw_data = ImGui::GetDrawData();
+		ImGui_ImplSDLRenderer3_RenderDrawData(draw_data, renderer);
 		SDL_RenderPresent(renderer);
+		// ImGui issues one draw call per command
+		frame_stats.ui_draw_calls = 0;
+		for (int i = 0; i < draw_data->CmdListsCount; i++)
+			frame_stats.ui_draw_calls += draw_data->CmdLists[i]->CmdBuffer.Size;
+		// Smoothed, or the number changes too fast to read
+		double frame_ms{static_cast<double>(SDL_GetTicksNS() - frame_start) / SDL_NS_PER_MS};
+		frame_stats.frame_ms += (frame_ms - frame_stats.frame_ms) * 0.1;
+		dirty_frames--;
+		frames_rendered++;
+		if (g_state.frame_cap > 0) {
+			next_frame = SDL_GetTicksNS() +
+					SDL_NS_PER_SECOND / static_cast<Uint64>(g_state.frame_cap);
+		}
 	}
 
 	ImGui_ImplSDLRenderer3_Shutdown();
@@ -630,65 +786,68 @@ void App::run() {
 	ImGui::DestroyContext();
 }
 
-void App::drawBoardBackground() const {
+float App::squareSize() const {
 	int w, h;
-	SDL_GetWindowSize(window, &w, &h);
-	auto board_size{static_cast<float>(std::min(h, w))};
-	auto square_size{board_size / 8};
-	for (int i = 0; i < 8; i++) {
-		for (int j = 0; j < 8; j++) {
-			SDL_FRect square{j * square_size, i * square_size, square_size, square_size};
-			if ((i + j) % 2 == 0)
-				SDL_SetRenderDrawColor(renderer, 0, 180, 0, 255);
-			else
-				SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-			SDL_RenderFillRect(renderer, &square);
-			if (g_state.selected_sq.x == j && g_state.selected_sq.y == i) {
-				SDL_SetRenderDrawColor(renderer, 200, 255, 200, 100);
-				SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-				SDL_RenderFillRect(renderer, &square);
-				SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
-			}
-			for (auto& m : g_state.valid_moves) {
-				if (m.x == j && m.y == i) {
-					SDL_SetRenderDrawColor(renderer, 50, 255, 50, 128);
-					SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-					SDL_FRect dot = {square.x + square.w / 3, square.y + square.h / 3, square.w / 3,
-						square.h / 3};
-					SDL_RenderFillRect(renderer, &dot);
-					SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
-				}
-			}
+	SDL_GetCurrentRenderOutputSize(renderer, &w, &h);
+	return static_cast<float>(std::min(w, h)) / 8;
+}
+
+void App::drawBoardBackground() {
+	float square_size{squareSize()};
+	// Where the selected piece can go, so every square is a single bit test
+	Bitboard targets{0};
+	for (Move m : g_state.valid_moves)
+		targets |= squareBB(m.to());
+	int selected{g_state.selected_sq.x == -1 ?
+				-1 :
+				g_state.selected_sq.y * 8 + g_state.selected_sq.x};
+
+	const SDL_FRect solid{atlasSolid(g_state.atlas_cell)};
+	for (int sq = 0; sq < 64; sq++) {
+		int i = sq / 8, j = sq % 8;
+		SDL_FRect square{j * square_size, i * square_size, square_size, square_size};
+		g_state.batch.add(square, solid, (i + j) % 2 == 0 ? rgba(0, 180, 0) : rgba(0, 0, 0));
+		if (sq == selected)
+			g_state.batch.add(square, solid, rgba(200, 255, 200, 100));
+		if (targets & squareBB(sq)) {
+			SDL_FRect dot{square.x + square.w / 3, square.y + square.h / 3, square.w / 3,
+				square.h / 3};
+			g_state.batch.add(dot, solid, rgba(50, 255, 50, 128));
 		}
 	}
+	drawBatch();
 }
 
-void App::renderBoard() const {
-	int w, h;
-	SDL_GetWindowSize(window, &w, &h);
-	float board_size = std::min(w, h);
-	float square_size = board_size / 8;
+void App::renderBoard() {
+	// Rather an empty board for the first few milliseconds than placeholder squares
+	if (g_state.atlas_cell == 0)
+		return;
+	float square_size{squareSize()};
 	for (int y = 0; y < 8; y++) {
 		for (int x = 0; x < 8; x++) {
-			auto& piece = board[y * 8 + x];
-			if (piece) {
-				char c = getPieceChar(piece);
-				if (g_state.textures.count(c)) {
-					SDL_FRect dest = {x * square_size, y * square_size, square_size, square_size};
-					SDL_RenderTexture(renderer, g_state.textures[c], nullptr, &dest);
-				} else {
-					SDL_SetRenderDrawColor(
-							renderer, piece->getColor() == Color::WHITE ? 200 : 50, 50, 50, 255);
-					SDL_FRect rect = {x * square_size + 15, y * square_size + 15, square_size - 30,
-						square_size - 30};
-					SDL_RenderFillRect(renderer, &rect);
-				}
+			PieceCode piece = game.position().pieceAt(y * 8 + x);
+			if (piece == no_piece)
+				continue;
+			if (g_state.piece_loaded[piece]) {
+				SDL_FRect dest = {x * square_size, y * square_size, square_size, square_size};
+				g_state.batch.add(dest, atlasCell(piece, g_state.atlas_cell), rgba(255, 255, 255));
+			} else {
+				SDL_FRect rect = {x * square_size + 15, y * square_size + 15, square_size - 30,
+					square_size - 30};
+				g_state.batch.add(rect, atlasSolid(g_state.atlas_cell),
+						rgba(colorOf(piece) == Color::WHITE ? 200 : 50, 50, 50));
 			}
 		}
 	}
+	drawBatch();
 }
 
 App::~App() {
+	if (g_state.persist_cache && !g_state.engine_cache.save(engine_cache_path))
+		std::println(stderr, "could not save the engine cache to {}", engine_cache_path);
+	// Its workers may still wake the event loop
+	g_state.piece_images.shutdown();
+	SDL_DestroyTexture(g_state.atlas);
 	SDL_DestroyRenderer(this->renderer);
 	SDL_DestroyWindow(this->window);
 	SDL_Quit();
@@ -0,0 +1,155 @@
+#include "bitboard.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+std::array<Magic, 64> rook_magics;
+std::array<Magic, 64> bishop_magics;
+Bitboard between_bb[64][64];
+Bitboard line_bb[64][64];
+
+namespace {
+
+// Sum over all squares of 2^(relevant blockers)
+Bitboard rook_table[0x19000];
+Bitboard bishop_table[0x1480];
+
+constexpr int rook_directions[4][2] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}};
+constexpr int bishop_directions[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+constexpr Bitboard file_a{0x0101010101010101};
+constexpr Bitboard file_h{file_a << 7};
+constexpr Bitboard rank_8{0xFF};
+constexpr Bitboard rank_1{rank_8 << 56};
+
+Bitboard slidingAttacks(int sq, Bitboard occupied, const int (&directions)[4][2]) {
+	Bitboard attacks = 0;
+	for (const auto& dir : directions) {
+		int x = sq % 8 + dir[0];
+		int y = sq / 8 + dir[1];
+		while (x >= 0 && x < 8 && y >= 0 && y < 8) {
+			Bitboard b = squareBB(y * 8 + x);
+			attacks |= b;
+			if (occupied & b)
+				break;
+			x += dir[0];
+			y += dir[1];
+		}
+	}
+	return attacks;
+}
+
+// Found offline with the usual sparse-random trial search for this board layout (a8 = bit 0).
+// Fixed numbers keep startup to filling the tables; initMagics still checks every blocker set.
+constexpr Bitboard rook_magic_numbers[64] = {
+	0x0080068051e04000, 0x0040001000402000, 0x0080100020008008, 0x4e000a0010208440,
+	0x4200040802002010, 0x0100010008020400, 0x9080608019000600, 0x8100020080204100,
+	0x4103800480400020, 0x8015004004802100, 0x000200108a002040, 0x0801000821001000,
+	0x0015000500080070, 0x0120800400800200, 0x0109000432001100, 0x020080055b000080,
+	0x0080004000402002, 0x5260848020004008, 0x2402020014402080, 0x3000808010000802,
+	0x0304018004810800, 0x0000808004000200, 0x0002040001500248, 0x0012020000408401,
+	0x8440008080004020, 0x0804200840100040, 0x0820008080201000, 0x2080100100082100,
+	0x0001000500100800, 0x00a1000900028400, 0x0100100400c80102, 0x000001120000a044,
+	0x800080c004800620, 0x4040081000202000, 0x0d08802008801000, 0x1000800800801004,
+	0x1004000801010010, 0x0402800400800200, 0x0004080204008110, 0x0000404082000401,
+	0x00c0118861408000, 0x1100220081020048, 0x09a0430420050010, 0x0000082200420010,
+	0x2110080004008080, 0x2004201040680104, 0x1106001451820008, 0x0002224104820014,
+	0x00800c8044210500, 0x02a0200040100040, 0x040100a0001e4100, 0x00204023108a0200,
+	0x2400080080040080, 0x1289008400020900, 0x0002088250010400, 0x0001006084010200,
+	0x0001023480002141, 0x0006400021810015, 0x8400100840200101, 0x40003000a1000825,
+	0x1002011008200402, 0x100d000400080201, 0x0020048806102904, 0x8401000020804201,
+};
+
+constexpr Bitboard bishop_magic_numbers[64] = {
+	0x0842244818044480, 0x0084b02220410210, 0x0008180060801200, 0x8204104210048000,
+	0x4002121007804021, 0x0102020220400000, 0x000404040b190050, 0x0089008210020208,
+	0xa208041004014402, 0xd088908202004610, 0x0088083250420010, 0x0048040410904801,
+	0x0002011040020000, 0x8000031002900840, 0x0504041101082204, 0x4440804208010818,
+	0x6120084002022210, 0x09420d1090010920, 0x8028004500440085, 0x0c140208401020a0,
+	0x8001000820080000, 0x000040020100a000, 0x801240008c108820, 0x0048410092080108,
+	0xe023204048281001, 0x4004100a20024080, 0x0004100006410242, 0x0010104014040002,
+	0x0002040012009040, 0x0008204062010080, 0x002401000090b000, 0x3000802005010800,
+	0x0810108804900200, 0x0002100242040880, 0x0002e11008110400, 0x0201010800050040,
+	0x8108020400801100, 0x8801020408220109, 0x00010a0224008808, 0x2008411020210080,
+	0x9014241444004004, 0x001041088801a052, 0x0010202030041801, 0x0080004208000080,
+	0x0000420202004410, 0x4001010101004201, 0x00280d0848800202, 0x0010840080892020,
+	0x0028841023100010, 0xa011010090048061, 0x8211210405240041, 0x0000000041108200,
+	0x40820030020a0700, 0x211040021c451128, 0x2014540888130c00, 0x0012280903020000,
+	0x1002120104124000, 0x01005c220222a004, 0x0080004202010420, 0x0048100040208810,
+	0x0000000004218600, 0x4000200520040100, 0x0104066042040104, 0x0c40080810404044,
+};
+
+Bitboard occupancy[4096];
+Bitboard reference[4096];
+
+bool initMagics(std::array<Magic, 64>& magics, Bitboard* table, const int (&directions)[4][2],
+		[[maybe_unused]] const Bitboard (&numbers)[64]) {
+	size_t offset = 0;
+
+	for (int sq = 0; sq < 64; sq++) {
+		// Pieces on the board edge never block anything further along the ray
+		Bitboard file = file_a << (sq % 8);
+		Bitboard rank = rank_8 << (sq / 8 * 8);
+		Bitboard edges = ((rank_8 | rank_1) & ~rank) | ((file_a | file_h) & ~file);
+
+		Magic& m = magics[sq];
+		m.mask = slidingAttacks(sq, 0, directions) & ~edges;
+		m.shift = 64 - popCount(m.mask);
+		m.attacks = table + offset;
+#ifndef USE_PEXT
+		m.magic = numbers[sq];
+#endif
+
+		// Carry-Rippler walk over every subset of the mask
+		int size = 0;
+		Bitboard b = 0;
+		do {
+			occupancy[size] = b;
+			reference[size] = slidingAttacks(sq, b, directions);
+			size++;
+			b = (b - m.mask) & m.mask;
+		} while (b);
+		offset += size;
+
+		// Constructive collisions (same attack set) are fine, anything else means a bad magic
+		std::fill(m.attacks, m.attacks + size, 0);
+		for (int i = 0; i < size; i++) {
+			Bitboard& entry = m.attacks[m.index(occupancy[i])];
+			if (entry && entry != reference[i])
+				return false;
+			entry = reference[i];
+		}
+	}
+	return true;
+}
+
+void initLines() {
+	for (int a = 0; a < 64; a++) {
+		for (int b = 0; b < 64; b++) {
+			if (a == b)
+				continue;
+			for (auto attacks : {rookAttacks, bishopAttacks}) {
+				if (attacks(a, 0) & squareBB(b)) {
+					line_bb[a][b] = (attacks(a, 0) & attacks(b, 0)) | squareBB(a) | squareBB(b);
+					between_bb[a][b] = attacks(a, squareBB(b)) & attacks(b, squareBB(a));
+				}
+			}
+		}
+	}
+}
+
+} // namespace
+
+std::chrono::microseconds Bitboards::init() {
+	static const std::chrono::microseconds elapsed = [] {
+		auto start = std::chrono::steady_clock::now();
+		bool ok = initMagics(rook_magics, rook_table, rook_directions, rook_magic_numbers) &&
+				initMagics(bishop_magics, bishop_table, bishop_directions, bishop_magic_numbers);
+		if (!ok)
+			std::abort();
+		initLines();
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - start);
+	}();
+	return elapsed;
+}
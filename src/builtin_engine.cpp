@@ -0,0 +1,210 @@
+#include "builtin_engine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+BuiltinEngine::BuiltinEngine() {
+	Bitboards::init();
+	search.onIteration([this](const SearchResult& result) { reportIteration(result); });
+}
+
+BuiltinEngine::~BuiltinEngine() {
+	halt();
+}
+
+bool BuiltinEngine::start() {
+	return true;
+}
+
+void BuiltinEngine::stop() {
+	halt();
+	finished = false;
+}
+
+void BuiltinEngine::newGame() {
+	// Nothing to spawn or handshake with; only forgetting the last game costs time
+	auto start = std::chrono::steady_clock::now();
+	halt();
+	finished = false;
+	tt.clear();
+	engine_timings.newgame_ms = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start)
+					    .count();
+}
+
+void BuiltinEngine::setSkillLevel(int level) {
+	// Strength only comes from depth: level 0 looks two plies ahead, level 20 twelve
+	max_depth = 2 + std::clamp(level, 0, 20) / 2;
+}
+
+void BuiltinEngine::setThreads(int threads) {
+	halt();
+	helpers.clear();
+	for (int id = 1; id < threads; id++)
+		helpers.push_back(std::make_unique<Search>(helper_stop, tt, id));
+}
+
+void BuiltinEngine::setHashSize(int megabytes) {
+	halt();
+	tt.resize(static_cast<size_t>(std::max(megabytes, 1)));
+}
+
+void BuiltinEngine::setPosition(const std::string& fen, const std::vector<std::string>& moves) {
+	halt();
+	finished = false;
+	discardAnalysis();
+	// Usually the game only grew by a move or two since the last call
+	std::optional<size_t> known = continueGame(fen, moves);
+	if (!known) {
+		known = 0;
+		game_keys.clear();
+		if (!position.setFEN(fen == "startpos" ? Position::start_fen : fen))
+			position = Position{};
+	}
+	for (size_t i = *known; i < moves.size(); i++) {
+		Move m = position.parseMove(moves[i]);
+		if (m == Move::none())
+			break;
+		game_keys.push_back(position.key());
+		position.makeMove(m);
+	}
+}
+
+void BuiltinEngine::go(int depth, int movetime_ms) {
+	startSearch({std::min(depth, max_depth), movetime_ms});
+}
+
+void BuiltinEngine::goPonder(int depth, int movetime_ms) {
+	startSearch({std::min(depth, max_depth), 0}, true);
+	ponder_movetime = movetime_ms;
+	ponder_start = std::chrono::steady_clock::now();
+}
+
+void BuiltinEngine::ponderHit() {
+	std::lock_guard lock(ponder_mutex);
+	if (!pondering)
+		return;
+	pondering = false;
+	ponder_cv.notify_all();
+
+	// Like UCI movetime, the time spent pondering counts
+	auto remaining = ponder_start + std::chrono::milliseconds(ponder_movetime) -
+			 std::chrono::steady_clock::now();
+	if (remaining <= std::chrono::steady_clock::duration::zero()) {
+		stop_flag = true;
+		return;
+	}
+	ponder_timer = std::jthread([this, remaining](std::stop_token token) {
+		std::mutex mutex;
+		std::condition_variable_any timer;
+		std::unique_lock timer_lock(mutex);
+		timer.wait_for(timer_lock, token, remaining, [] { return false; });
+		if (!token.stop_requested())
+			stop_flag = true;
+	});
+}
+
+void BuiltinEngine::setMultiPV(int) {
+	// Only the main line is searched; extra lines are not supported
+}
+
+void BuiltinEngine::goInfinite() {
+	// Analysis ignores the skill level
+	startSearch({Search::max_ply, 0});
+}
+
+void BuiltinEngine::stopSearch() {
+	halt();
+}
+
+void BuiltinEngine::startSearch(SearchLimits limits, bool ponder) {
+	halt();
+	finished = false;
+	stop_flag = false;
+	pondering = ponder;
+	worker = std::jthread([this, limits] {
+		tt.newSearch();
+		helper_stop = false;
+		std::vector<uint64_t> helper_nodes(helpers.size());
+		std::vector<std::jthread> helper_threads;
+		for (size_t i = 0; i < helpers.size(); i++) {
+			helper_threads.emplace_back([this, i, &helper_nodes, depth = limits.depth] {
+				helper_nodes[i] = helpers[i]->run(position, {depth, 0}, game_keys).nodes;
+			});
+		}
+
+		SearchResult result = search.run(position, limits, game_keys);
+		helper_stop = true;
+		helper_threads.clear();
+
+		// A ponder search that reached its depth holds the answer until the move is played; one
+		// stopped before that was pondering on the wrong move and answers nothing
+		{
+			std::unique_lock lock(ponder_mutex);
+			ponder_cv.wait(lock, [this] { return !pondering || stop_flag; });
+			if (pondering)
+				return;
+		}
+
+		// The iterations only counted the main thread's nodes
+		if (!helpers.empty()) {
+			for (uint64_t n : helper_nodes)
+				result.nodes += n;
+			reportIteration(result);
+		}
+		best_move = result.best;
+		ponder_reply = result.pv.size() > 1 ? result.pv[1] : Move::none();
+		finished.store(true, std::memory_order_release);
+		notifyReady();
+	});
+}
+
+std::optional<std::string> BuiltinEngine::getBestMove() {
+	if (!finished.exchange(false, std::memory_order_acquire))
+		return std::nullopt;
+	return best_move == Move::none() ? "(none)" : best_move.toUci();
+}
+
+std::string BuiltinEngine::getPonderMove() const {
+	return ponder_reply == Move::none() ? "" : ponder_reply.toUci();
+}
+
+void BuiltinEngine::reportIteration(const SearchResult& result) {
+	AnalysisUpdate update;
+	update.depth = result.depth;
+	update.seldepth = result.depth;
+	if (std::abs(result.score) >= Search::mate_score - Search::max_ply) {
+		// Plies to mate, turned into moves the way UCI counts them
+		int plies = Search::mate_score - std::abs(result.score);
+		update.mate = true;
+		update.score = (result.score > 0 ? 1 : -1) * (plies + 1) / 2;
+	} else {
+		update.score = result.score;
+	}
+	update.nodes = result.nodes;
+	update.time_ms = result.time_ms;
+	update.nps = result.nodes * 1000 / std::max<uint64_t>(result.time_ms, 1);
+	update.hashfull = tt.hashfull();
+	for (Move m : result.pv) {
+		if (update.pv_length == AnalysisUpdate::max_pv)
+			break;
+		std::string uci = m.toUci();
+		UciMove& move = update.pv[update.pv_length++];
+		move.length = static_cast<uint8_t>(uci.copy(move.text.data(), move.text.size()));
+	}
+	publishAnalysis(update);
+}
+
+void BuiltinEngine::halt() {
+	ponder_timer = {};
+	if (!worker.joinable())
+		return;
+	{
+		std::lock_guard lock(ponder_mutex);
+		stop_flag = true;
+	}
+	ponder_cv.notify_all();
+	worker.join();
+	pondering = false;
+}
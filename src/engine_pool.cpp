@@ -0,0 +1,226 @@
+#include "engine_pool.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+EnginePool::EnginePool(const std::string& path, size_t count, int hash, std::optional<int> nice,
+		bool pin)
+	: engines(count)
+	, hash_mb(hash) {
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	wake_fd = eventfd(0, EFD_CLOEXEC);
+	epoll_event wake_event{EPOLLIN, {.u64 = count}};
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake_event);
+
+	int cpus = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	for (size_t i = 0; i < count; i++) {
+		Slot& slot = engines[i];
+		ProcessLimits limits;
+		limits.nice = nice;
+		if (pin)
+			limits.cpus.push_back(static_cast<int>(i) % cpus);
+		if (!spawnProcess(path, slot.process, limits))
+			continue;
+		epoll_event event{EPOLLIN, {.u64 = i}};
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, slot.process.stdout_fd, &event);
+		slot.state = State::STARTING;
+		send(slot, "uci");
+	}
+	thread = std::jthread([this] { eventLoop(); });
+}
+
+EnginePool::~EnginePool() {
+	{
+		std::lock_guard lock(queue_mutex);
+		stopping = true;
+	}
+	uint64_t one = 1;
+	write(wake_fd, &one, sizeof(one));
+	thread.join();
+	close(wake_fd);
+	close(epoll_fd);
+}
+
+void EnginePool::submit(AnalysisJob job, Callback callback) {
+	{
+		std::lock_guard lock(queue_mutex);
+		queue.push_back({std::move(job), std::move(callback)});
+	}
+	uint64_t one = 1;
+	write(wake_fd, &one, sizeof(one));
+}
+
+std::future<AnalysisResult> EnginePool::submit(AnalysisJob job) {
+	// std::function needs a copyable callable
+	auto promise = std::make_shared<std::promise<AnalysisResult>>();
+	std::future<AnalysisResult> result = promise->get_future();
+	submit(std::move(job), [promise](const AnalysisResult& r) { promise->set_value(r); });
+	return result;
+}
+
+void EnginePool::eventLoop() {
+	std::array<epoll_event, 64> events;
+	while (true) {
+		int ready = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+		if (ready < 0 && errno != EINTR)
+			break;
+		for (int i = 0; i < ready; i++) {
+			size_t index = events[i].data.u64;
+			if (index == engines.size()) {
+				uint64_t count;
+				read(wake_fd, &count, sizeof(count));
+			} else {
+				readOutput(engines[index]);
+			}
+		}
+		{
+			std::lock_guard lock(queue_mutex);
+			if (stopping)
+				break;
+		}
+		dispatch();
+	}
+	shutdown();
+}
+
+void EnginePool::readOutput(Slot& slot) {
+	char buffer[4096];
+	ssize_t bytes = read(slot.process.stdout_fd, buffer, sizeof(buffer));
+	if (bytes < 0 && (errno == EAGAIN || errno == EINTR))
+		return;
+	// EOF: the engine exited or could not be executed
+	if (bytes <= 0) {
+		kill(slot);
+		return;
+	}
+
+	slot.output.append(buffer, static_cast<size_t>(bytes));
+	size_t start = 0;
+	for (size_t end; (end = slot.output.find('\n', start)) != std::string::npos; start = end + 1) {
+		std::string_view line(slot.output.data() + start, end - start);
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+		handleLine(slot, line);
+	}
+	slot.output.erase(0, start);
+}
+
+void EnginePool::handleLine(Slot& slot, std::string_view line) {
+	switch (slot.state) {
+	case State::STARTING:
+		if (line == "uciok") {
+			// Parallelism comes from the number of engines, not from threads inside each one
+			send(slot, "setoption name Threads value 1");
+			send(slot, "setoption name Hash value " + std::to_string(hash_mb));
+			send(slot, "isready");
+			slot.state = State::SYNCING;
+		}
+		break;
+	case State::SYNCING:
+		if (line == "readyok")
+			slot.state = State::IDLE;
+		break;
+	case State::BUSY:
+		if (line.starts_with("info ")) {
+			AnalysisUpdate update;
+			if (parseInfoLine(line, update) && update.multipv == 1)
+				slot.result.info = update;
+		} else if (line.starts_with("bestmove ")) {
+			std::string_view move = line.substr(9);
+			slot.result.best_move = move.substr(0, move.find(' '));
+			slot.state = State::IDLE;
+			finish(slot);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void EnginePool::dispatch() {
+	std::vector<Pending> failed;
+	{
+		std::lock_guard lock(queue_mutex);
+		bool any_alive = false;
+		for (Slot& slot : engines) {
+			any_alive |= slot.state != State::DEAD;
+			if (slot.state != State::IDLE || queue.empty())
+				continue;
+			Pending pending = std::move(queue.front());
+			queue.pop_front();
+
+			const AnalysisJob& job = pending.job;
+			std::string position = "position fen " + job.fen;
+			if (!job.moves.empty()) {
+				position += " moves";
+				for (const std::string& m : job.moves)
+					position += " " + m;
+			}
+			std::string go = "go depth " + std::to_string(job.limits.depth);
+			if (job.limits.movetime_ms > 0)
+				go += " movetime " + std::to_string(job.limits.movetime_ms);
+			send(slot, position);
+			send(slot, go);
+			slot.state = State::BUSY;
+			slot.callback = std::move(pending.callback);
+			slot.result = {};
+		}
+		if (!any_alive) {
+			failed.assign(std::make_move_iterator(queue.begin()),
+					std::make_move_iterator(queue.end()));
+			queue.clear();
+		}
+	}
+	// Outside the lock, a callback may submit more work
+	for (Pending& pending : failed)
+		pending.callback({});
+}
+
+void EnginePool::finish(Slot& slot) {
+	Callback callback = std::move(slot.callback);
+	slot.callback = nullptr;
+	if (callback)
+		callback(slot.result);
+}
+
+void EnginePool::kill(Slot& slot) {
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, slot.process.stdout_fd, nullptr);
+	closeProcess(slot.process);
+	bool busy = slot.state == State::BUSY;
+	slot.state = State::DEAD;
+	if (busy) {
+		slot.result.best_move.clear();
+		finish(slot);
+	}
+}
+
+void EnginePool::shutdown() {
+	for (Slot& slot : engines) {
+		if (slot.state != State::DEAD)
+			send(slot, "quit");
+	}
+	for (Slot& slot : engines) {
+		if (slot.process.pid >= 0)
+			kill(slot);
+	}
+	std::deque<Pending> left;
+	{
+		std::lock_guard lock(queue_mutex);
+		left.swap(queue);
+	}
+	for (Pending& pending : left)
+		pending.callback({});
+}
+
+void EnginePool::send(const Slot& slot, const std::string& cmd) {
+	std::string line = cmd + "\n";
+	write(slot.process.stdin_fd, line.data(), line.size());
+}
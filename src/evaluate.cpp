@@ -0,0 +1,92 @@
+#include "evaluate.hpp"
+
+namespace {
+
+// Piece-square bonuses from white's point of view, laid out like the board array (a8 first).
+// Black looks squares up mirrored vertically.
+using Table = std::array<int, 64>;
+
+// clang-format off
+constexpr Table pawn_table{
+	0, 0, 0, 0, 0, 0, 0, 0,
+	50, 50, 50, 50, 50, 50, 50, 50,
+	10, 10, 20, 30, 30, 20, 10, 10,
+	5, 5, 10, 25, 25, 10, 5, 5,
+	0, 0, 0, 20, 20, 0, 0, 0,
+	5, -5, -10, 0, 0, -10, -5, 5,
+	5, 10, 10, -20, -20, 10, 10, 5,
+	0, 0, 0, 0, 0, 0, 0, 0};
+
+constexpr Table rook_table{
+	0, 0, 0, 0, 0, 0, 0, 0,
+	5, 10, 10, 10, 10, 10, 10, 5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	0, 0, 0, 5, 5, 0, 0, 0};
+
+constexpr Table knight_table{
+	-50, -40, -30, -30, -30, -30, -40, -50,
+	-40, -20, 0, 0, 0, 0, -20, -40,
+	-30, 0, 10, 15, 15, 10, 0, -30,
+	-30, 5, 15, 20, 20, 15, 5, -30,
+	-30, 0, 15, 20, 20, 15, 0, -30,
+	-30, 5, 10, 15, 15, 10, 5, -30,
+	-40, -20, 0, 5, 5, 0, -20, -40,
+	-50, -40, -30, -30, -30, -30, -40, -50};
+
+constexpr Table bishop_table{
+	-20, -10, -10, -10, -10, -10, -10, -20,
+	-10, 0, 0, 0, 0, 0, 0, -10,
+	-10, 0, 5, 10, 10, 5, 0, -10,
+	-10, 5, 5, 10, 10, 5, 5, -10,
+	-10, 0, 10, 10, 10, 10, 0, -10,
+	-10, 10, 10, 10, 10, 10, 10, -10,
+	-10, 5, 0, 0, 0, 0, 5, -10,
+	-20, -10, -10, -10, -10, -10, -10, -20};
+
+constexpr Table queen_table{
+	-20, -10, -10, -5, -5, -10, -10, -20,
+	-10, 0, 0, 0, 0, 0, 0, -10,
+	-10, 0, 5, 5, 5, 5, 0, -10,
+	-5, 0, 5, 5, 5, 5, 0, -5,
+	0, 0, 5, 5, 5, 5, 0, -5,
+	-10, 5, 5, 5, 5, 5, 0, -10,
+	-10, 0, 5, 0, 0, 0, 0, -10,
+	-20, -10, -10, -5, -5, -10, -10, -20};
+
+// Middlegame king: stay behind the pawns, preferably castled
+constexpr Table king_table{
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-20, -30, -30, -40, -40, -30, -30, -20,
+	-10, -20, -20, -20, -20, -20, -20, -10,
+	20, 20, 0, 0, 0, 0, 20, 20,
+	20, 30, 10, 0, 0, 10, 30, 20};
+// clang-format on
+
+// Indexed by PieceType
+constexpr std::array<const Table*, 6> tables{
+	&pawn_table, &rook_table, &knight_table, &bishop_table, &queen_table, &king_table};
+
+} // namespace
+
+int evaluate(const Position& pos) {
+	int score{0};
+	for (int t = 0; t < 6; t++) {
+		auto type = static_cast<PieceType>(t);
+		const Table& table = *tables[t];
+		Bitboard white = pos.pieces(Color::WHITE, type);
+		Bitboard black = pos.pieces(Color::BLACK, type);
+		score += piece_values[t] * (popCount(white) - popCount(black));
+		while (white)
+			score += table[popLsb(white)];
+		while (black)
+			score -= table[popLsb(black) ^ 56];
+	}
+	return pos.sideToMove() == Color::WHITE ? score : -score;
+}
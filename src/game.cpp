@@ -0,0 +1,145 @@
+#include "game.hpp"
+
+#include "bitboard.hpp"
+
+#include <algorithm>
+
+Game::Game(const std::string& fen, TimeControl control) {
+	Bitboards::init();
+	reset(fen, control);
+}
+
+bool Game::reset(const std::string& fen, TimeControl control) {
+	bool ok = pos.setFEN(fen == "startpos" ? Position::start_fen : fen);
+	start_fen = ok ? fen : "startpos";
+	if (!ok)
+		pos.setFEN(Position::start_fen);
+	history.clear();
+	uci_moves.clear();
+	keys.assign(1, pos.key());
+	time_control = control;
+	clocks.fill(time_control.base_ms);
+	result = GameResult::ONGOING;
+	end = GameEnd::NONE;
+	update();
+	return ok;
+}
+
+void Game::legalMovesFrom(int from, MoveList& moves) const {
+	moves.clear();
+	for (Move m : legal) {
+		if (m.from() == from)
+			moves.push_back(m);
+	}
+}
+
+bool Game::play(Move m, int64_t spent_ms) {
+	if (isOver() || !legal.contains(m))
+		return false;
+
+	int side = static_cast<int>(pos.sideToMove());
+	int64_t clock = clocks[side];
+	if (timed()) {
+		// The flag fell before the move was made
+		if (spent_ms >= clock) {
+			clocks[side] = 0;
+			result = side == static_cast<int>(Color::WHITE) ? GameResult::BLACK_WINS :
+									  GameResult::WHITE_WINS;
+			end = GameEnd::TIME;
+			return false;
+		}
+		clocks[side] = clock - spent_ms + time_control.increment_ms;
+	}
+
+	uci_moves.push_back(m.toUci());
+	history.push_back({m, pos.makeMove(m), clock});
+	keys.push_back(pos.key());
+	update();
+	return true;
+}
+
+bool Game::play(std::string_view uci, int64_t spent_ms) {
+	return play(pos.parseMove(uci), spent_ms);
+}
+
+bool Game::takeBack() {
+	if (history.empty())
+		return false;
+	const PlayedMove& last = history.back();
+	pos.undoMove(last.move, last.undo);
+	clocks[static_cast<int>(pos.sideToMove())] = last.clock;
+	history.pop_back();
+	uci_moves.pop_back();
+	keys.pop_back();
+	result = GameResult::ONGOING;
+	end = GameEnd::NONE;
+	update();
+	return true;
+}
+
+void Game::adjudicate(GameResult game_result) {
+	if (isOver() || game_result == GameResult::ONGOING)
+		return;
+	result = game_result;
+	end = GameEnd::NONE;
+}
+
+std::string Game::status() const {
+	switch (end) {
+	case GameEnd::CHECKMATE:
+		return "Checkmate!";
+	case GameEnd::STALEMATE:
+		return "Stalemate!";
+	case GameEnd::REPETITION:
+		return "Draw by repetition!";
+	case GameEnd::FIFTY_MOVES:
+		return "Draw by the fifty-move rule!";
+	case GameEnd::TIME:
+		return result == GameResult::WHITE_WINS ? "Black lost on time!" : "White lost on time!";
+	case GameEnd::NONE:
+	default:
+		break;
+	}
+	if (isOver())
+		return std::string("Game over: ") + toString(result);
+	if (pos.inCheck())
+		return "Check!";
+	return pos.sideToMove() == Color::WHITE ? "White to move" : "Black to move";
+}
+
+void Game::update() {
+	legal.clear();
+	generateLegalMoves(pos, legal);
+
+	auto repetitions = std::count(keys.begin(), keys.end(), pos.key());
+	if (legal.empty()) {
+		bool mated = pos.inCheck();
+		end = mated ? GameEnd::CHECKMATE : GameEnd::STALEMATE;
+		if (!mated)
+			result = GameResult::DRAW;
+		else if (pos.sideToMove() == Color::WHITE)
+			result = GameResult::BLACK_WINS;
+		else
+			result = GameResult::WHITE_WINS;
+	} else if (repetitions >= 3) {
+		end = GameEnd::REPETITION;
+		result = GameResult::DRAW;
+	} else if (pos.halfmoveClock() >= 100) {
+		end = GameEnd::FIFTY_MOVES;
+		result = GameResult::DRAW;
+	}
+}
+
+const char* toString(GameResult result) {
+	switch (result) {
+	case GameResult::WHITE_WINS:
+		return "1-0";
+	case GameResult::BLACK_WINS:
+		return "0-1";
+	case GameResult::DRAW:
+		return "1/2-1/2";
+	case GameResult::ONGOING:
+	default:
+		return "*";
+	}
+}
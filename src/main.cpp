@@ -1,3 +1,4 @@
+#include <csignal>
 #include <cstdint>
 #include <print>
 
@@ -6,6 +7,8 @@
 #include "app.hpp"
 
 int32_t main(int32_t argc, char** argv) {
+	// An engine that dies mid-session must not take the GUI down with it on the next write
+	std::signal(SIGPIPE, SIG_IGN);
 	for (size_t i = 0; i < static_cast<size_t>(argc); i++) {
 		std::println("args: {}", argv[i]);
 	}
@@ -0,0 +1,79 @@
+#include "movegen.hpp"
+#include "piece.hpp"
+
+Bitboard pinnedPieces(const Position& pos) {
+	Color us = pos.sideToMove();
+	Color them = ~us;
+	int ksq = pos.kingSquare(us);
+	Bitboard queens = pos.pieces(them, PieceType::QUEEN);
+	Bitboard snipers =
+			(rookAttacks(ksq, 0) & (pos.pieces(them, PieceType::ROOK) | queens)) |
+			(bishopAttacks(ksq, 0) & (pos.pieces(them, PieceType::BISHOP) | queens));
+
+	Bitboard pinned = 0;
+	while (snipers) {
+		Bitboard blockers = betweenBB(ksq, popLsb(snipers)) & pos.occupied();
+		if (popCount(blockers) == 1)
+			pinned |= blockers & pos.pieces(us);
+	}
+	return pinned;
+}
+
+void generateLegalMoves(const Position& pos, MoveList& moves) {
+	Color us = pos.sideToMove();
+	Color them = ~us;
+	int ksq = pos.kingSquare(us);
+	Bitboard checkers = pos.checkers();
+
+	// King moves: the destination must be safe once the king has left its square, so sliders
+	// checking along a line are not blocked by the king itself
+	size_t first = moves.size();
+	getPieceMoves(pos, ksq, moves);
+	Bitboard without_king = pos.occupied() ^ squareBB(ksq);
+	size_t kept = first;
+	for (size_t i = first; i < moves.size(); i++) {
+		Move m = moves[i];
+		if (!(pos.attackersTo(m.to(), without_king) & pos.pieces(them)))
+			moves[kept++] = m;
+	}
+	moves.resize(kept);
+
+	// In double check only the king can move
+	if (popCount(checkers) > 1)
+		return;
+
+	// Single check: every other move has to capture the checker or block the line
+	Bitboard check_mask = ~Bitboard{0};
+	if (checkers)
+		check_mask = betweenBB(ksq, lsb(checkers)) | checkers;
+	Bitboard pinned = pinnedPieces(pos);
+
+	Bitboard own = pos.pieces(us) ^ squareBB(ksq);
+	while (own) {
+		int from = popLsb(own);
+		first = moves.size();
+		getPieceMoves(pos, from, moves);
+		kept = first;
+		for (size_t i = first; i < moves.size(); i++) {
+			Move m = moves[i];
+			if (m.flags() == Move::EP_CAPTURE) {
+				// Taking en passant removes two pieces from the same rank, which can uncover a
+				// slider no pin mask accounts for, so test the resulting occupancy directly
+				int captured = (from / 8) * 8 + m.to() % 8;
+				Bitboard occupied =
+						(pos.occupied() ^ squareBB(from) ^ squareBB(captured)) | squareBB(m.to());
+				Bitboard attackers =
+						pos.attackersTo(ksq, occupied) & pos.pieces(them) & ~squareBB(captured);
+				if (!attackers)
+					moves[kept++] = m;
+				continue;
+			}
+			if (!(check_mask & squareBB(m.to())))
+				continue;
+			if ((pinned & squareBB(from)) && !(lineBB(ksq, from) & squareBB(m.to())))
+				continue;
+			moves[kept++] = m;
+		}
+		moves.resize(kept);
+	}
+}
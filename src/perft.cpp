@@ -0,0 +1,121 @@
+#include "perft.hpp"
+#include "movegen.hpp"
+#include "thread_pool.hpp"
+
+#include <bit>
+
+namespace {
+
+// Folded into the position key so one position at different depths uses different slots
+constexpr uint64_t depthKey(int depth) {
+	return static_cast<uint64_t>(depth) * 0x9E3779B97F4A7C15;
+}
+
+} // namespace
+
+PerftHash::PerftHash(size_t megabytes) {
+	size_t count = megabytes * 1024 * 1024 / sizeof(Entry);
+	if (count < 2)
+		return;
+	count = std::bit_floor(count);
+	entries = std::make_unique<Entry[]>(count);
+	mask = count - 1;
+}
+
+bool PerftHash::probe(uint64_t key, int depth, uint64_t& nodes) const {
+	if (!entries)
+		return false;
+	uint64_t hash_key = key ^ depthKey(depth);
+	size_t bucket = hash_key & mask & ~size_t{1};
+	for (size_t i = bucket; i < bucket + 2; i++) {
+		uint64_t data = entries[i].data.load(std::memory_order_relaxed);
+		uint64_t check = entries[i].check.load(std::memory_order_relaxed);
+		if ((check ^ data) == hash_key && static_cast<int>(data & 0xFF) == depth) {
+			nodes = data >> 8;
+			return true;
+		}
+	}
+	return false;
+}
+
+void PerftHash::store(uint64_t key, int depth, uint64_t nodes) {
+	if (!entries)
+		return;
+	uint64_t hash_key = key ^ depthKey(depth);
+	size_t bucket = hash_key & mask & ~size_t{1};
+	uint64_t data = nodes << 8 | static_cast<uint64_t>(depth);
+	// Deeper subtrees are worth more, so the first slot only gives way to an equal or deeper one
+	int kept = static_cast<int>(entries[bucket].data.load(std::memory_order_relaxed) & 0xFF);
+	Entry& entry = depth >= kept ? entries[bucket] : entries[bucket + 1];
+	entry.check.store(hash_key ^ data, std::memory_order_relaxed);
+	entry.data.store(data, std::memory_order_relaxed);
+}
+
+void PerftHash::clear() {
+	for (size_t i = 0; i < entryCount() && entries; i++) {
+		entries[i].check.store(0, std::memory_order_relaxed);
+		entries[i].data.store(0, std::memory_order_relaxed);
+	}
+}
+
+uint64_t perft(Position& pos, int depth, PerftHash* hash) {
+	if (depth <= 0)
+		return 1;
+
+	uint64_t nodes{0};
+	if (depth > 1 && hash && hash->probe(pos.key(), depth, nodes))
+		return nodes;
+
+	MoveList moves;
+	generateLegalMoves(pos, moves);
+	if (depth == 1)
+		return moves.size();
+
+	for (Move m : moves) {
+		UndoInfo undo = pos.makeMove(m);
+		nodes += perft(pos, depth - 1, hash);
+		pos.undoMove(m, undo);
+	}
+	if (hash)
+		hash->store(pos.key(), depth, nodes);
+	return nodes;
+}
+
+std::vector<DivideEntry> perftDivide(
+		Position& pos, int depth, PerftHash* hash, ThreadPool* pool) {
+	MoveList moves;
+	generateLegalMoves(pos, moves);
+
+	std::vector<DivideEntry> result;
+	result.reserve(moves.size());
+	if (!pool || depth < 3) {
+		for (Move m : moves) {
+			UndoInfo undo = pos.makeMove(m);
+			result.push_back({m, perft(pos, depth - 1, hash)});
+			pos.undoMove(m, undo);
+		}
+		return result;
+	}
+
+	// One task per reply to each root move gives a few hundred to a few thousand tasks, enough
+	// for stealing to even out subtrees of very different size
+	std::vector<std::atomic<uint64_t>> counts(moves.size());
+	for (size_t i = 0; i < moves.size(); i++) {
+		UndoInfo undo = pos.makeMove(moves[i]);
+		MoveList replies;
+		generateLegalMoves(pos, replies);
+		for (Move reply : replies) {
+			UndoInfo reply_undo = pos.makeMove(reply);
+			pool->submit([&counts, i, child = pos, depth, hash]() mutable {
+				counts[i].fetch_add(perft(child, depth - 2, hash), std::memory_order_relaxed);
+			});
+			pos.undoMove(reply, reply_undo);
+		}
+		pos.undoMove(moves[i], undo);
+	}
+	pool->wait();
+
+	for (size_t i = 0; i < moves.size(); i++)
+		result.push_back({moves[i], counts[i].load()});
+	return result;
+}
@@ -0,0 +1,322 @@
+#include "pgn.hpp"
+
+#include "bitboard.hpp"
+#include "san.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <thread>
+
+namespace {
+
+bool isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool parseResult(std::string_view token, GameResult& result) {
+	if (token == "1-0")
+		result = GameResult::WHITE_WINS;
+	else if (token == "0-1")
+		result = GameResult::BLACK_WINS;
+	else if (token == "1/2-1/2")
+		result = GameResult::DRAW;
+	else if (token == "*")
+		result = GameResult::ONGOING;
+	else
+		return false;
+	return true;
+}
+
+void appendTag(std::string& out, std::string_view name, std::string_view value) {
+	out += '[';
+	out += name;
+	out += " \"";
+	for (char c : value) {
+		if (c == '"' || c == '\\')
+			out += '\\';
+		out += c;
+	}
+	out += "\"]\n";
+}
+
+} // namespace
+
+PgnFile::~PgnFile() {
+	unmap();
+}
+
+bool PgnFile::open(const std::string& path) {
+	unmap();
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) < 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+	size_t length = static_cast<size_t>(st.st_size);
+	void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+	// Read front to back, once; the kernel can read ahead and drop pages behind
+	madvise(mapping, length, MADV_SEQUENTIAL);
+
+	data = static_cast<const char*>(mapping);
+	size = length;
+	return true;
+}
+
+void PgnFile::unmap() {
+	if (data)
+		munmap(const_cast<char*>(data), size);
+	data = nullptr;
+	size = 0;
+}
+
+std::string_view PgnGame::tag(std::string_view name) const {
+	for (const PgnTag& t : tags) {
+		if (t.name == name)
+			return t.value;
+	}
+	return {};
+}
+
+PgnReader::PgnReader(std::string_view pgn_text, size_t base_offset)
+	: text(pgn_text)
+	, base(base_offset) {
+	Bitboards::init();
+	start_position.setFEN(Position::start_fen);
+}
+
+bool PgnReader::next(PgnGame& game) {
+	game.tags.clear();
+	game.moves.clear();
+	game.result = GameResult::ONGOING;
+	game.broken = false;
+
+	skipSpace();
+	if (offset >= text.size())
+		return false;
+	game.offset = base + offset;
+
+	while (offset < text.size() && text[offset] == '[') {
+		readTag(game);
+		skipSpace();
+	}
+	game.start = start_position;
+	if (std::string_view fen = game.tag("FEN"); !fen.empty() && !game.start.setFEN(fen)) {
+		game.start = start_position;
+		game.broken = true;
+	}
+
+	// Movetext runs until the result, the tags of the next game or the end of the text
+	Position pos = game.start;
+	while (true) {
+		skipSpace();
+		if (offset >= text.size() || text[offset] == '[')
+			break;
+		char c = text[offset];
+		if (c == '{') {
+			size_t end = text.find('}', offset);
+			offset = end == std::string_view::npos ? text.size() : end + 1;
+		} else if (c == ';') {
+			size_t end = text.find('\n', offset);
+			offset = end == std::string_view::npos ? text.size() : end + 1;
+		} else if (c == '(') {
+			// Variations nest, and their comments may hold parentheses of their own
+			int depth = 0;
+			while (offset < text.size()) {
+				char v = text[offset++];
+				if (v == '{') {
+					size_t end = text.find('}', offset);
+					offset = end == std::string_view::npos ? text.size() : end + 1;
+				} else if (v == '(') {
+					depth++;
+				} else if (v == ')' && --depth == 0) {
+					break;
+				}
+			}
+		} else {
+			size_t start = offset;
+			while (offset < text.size() && !isSpace(text[offset]) && text[offset] != '{' &&
+					text[offset] != '(' && text[offset] != ';')
+				offset++;
+			if (!readToken(game, text.substr(start, offset - start), pos))
+				break;
+		}
+	}
+	return true;
+}
+
+// Whitespace, and `%` escape lines, which the standard reserves for other programs
+void PgnReader::skipSpace() {
+	while (offset < text.size()) {
+		char c = text[offset];
+		if (isSpace(c)) {
+			offset++;
+		} else if (c == '%' && (offset == 0 || text[offset - 1] == '\n')) {
+			size_t end = text.find('\n', offset);
+			offset = end == std::string_view::npos ? text.size() : end + 1;
+		} else {
+			break;
+		}
+	}
+}
+
+void PgnReader::readTag(PgnGame& game) {
+	size_t line_end = text.find('\n', offset);
+	if (line_end == std::string_view::npos)
+		line_end = text.size();
+	std::string_view line = text.substr(offset + 1, line_end - offset - 1);
+	// A broken tag costs the rest of its line, a good one only itself
+	offset = line_end;
+
+	size_t name_end = line.find_first_of(" \t\"]");
+	size_t open = line.find('"');
+	if (name_end == 0 || name_end == std::string_view::npos || open == std::string_view::npos)
+		return;
+	// The value ends at the first quote that is not escaped
+	size_t close = open + 1;
+	while (close < line.size() && line[close] != '"')
+		close += line[close] == '\\' ? 2 : 1;
+	size_t bracket = line.find(']', close);
+	if (close >= line.size() || bracket == std::string_view::npos)
+		return;
+	game.tags.push_back({line.substr(0, name_end), line.substr(open + 1, close - open - 1)});
+	offset = static_cast<size_t>(line.data() - text.data()) + bracket + 1;
+}
+
+bool PgnReader::readToken(PgnGame& game, std::string_view token, Position& pos) {
+	if (parseResult(token, game.result))
+		return false;
+	// "12." or "12..." may be glued to the move that follows, and a bare "12" is a number too.
+	// Other tokens starting with a digit, such as castling written "0-0", are moves.
+	if (token[0] >= '0' && token[0] <= '9') {
+		if (size_t dots = token.find_last_of('.'); dots != std::string_view::npos)
+			token.remove_prefix(dots + 1);
+		else if (token.find_first_not_of("0123456789") == std::string_view::npos)
+			return true;
+	}
+	if (token.empty() || token[0] == '$' || game.broken)
+		return true;
+
+	Move m = parseSan(pos, token);
+	if (m == Move::none()) {
+		game.broken = true;
+		return true;
+	}
+	game.moves.push_back(m);
+	pos.makeMove(m);
+	return true;
+}
+
+std::vector<size_t> splitPgn(std::string_view text, size_t count) {
+	std::vector<size_t> starts{0};
+	for (size_t i = 1; i < count; i++) {
+		size_t at = std::max(text.size() / count * i, starts.back() + 1) - 1;
+		while ((at = text.find("\n[", at)) != std::string_view::npos) {
+			bool blank_before = at > 0 &&
+					    (text[at - 1] == '\n' ||
+							    (text[at - 1] == '\r' && at > 1 && text[at - 2] == '\n'));
+			if (blank_before)
+				break;
+			at++;
+		}
+		if (at == std::string_view::npos)
+			break;
+		starts.push_back(at + 1);
+	}
+	return starts;
+}
+
+size_t readPgnParallel(std::string_view text, size_t threads,
+		const std::function<void(size_t chunk, const PgnGame& game)>& visit) {
+	std::vector<size_t> starts = splitPgn(text, std::max<size_t>(threads, 1));
+	std::atomic<size_t> games{0};
+	{
+		std::vector<std::jthread> workers;
+		for (size_t chunk = 0; chunk < starts.size(); chunk++) {
+			size_t begin = starts[chunk];
+			size_t end = chunk + 1 < starts.size() ? starts[chunk + 1] : text.size();
+			workers.emplace_back([&, chunk, begin, end] {
+				PgnReader reader(text.substr(begin, end - begin), begin);
+				PgnGame game;
+				size_t count = 0;
+				while (reader.next(game)) {
+					visit(chunk, game);
+					count++;
+				}
+				games += count;
+			});
+		}
+	}
+	return games;
+}
+
+void writePgn(std::string& out, const Game& game, const PgnHeaders& headers,
+		const std::vector<std::string>& comments) {
+	bool setup = game.startFen() != "startpos";
+	appendTag(out, "Event", headers.event);
+	appendTag(out, "Site", headers.site);
+	appendTag(out, "Date", headers.date);
+	appendTag(out, "Round", headers.round);
+	appendTag(out, "White", headers.white);
+	appendTag(out, "Black", headers.black);
+	appendTag(out, "Result", toString(game.outcome()));
+	if (setup) {
+		appendTag(out, "SetUp", "1");
+		appendTag(out, "FEN", game.startFen());
+	}
+	for (const auto& [name, value] : headers.extra)
+		appendTag(out, name, value);
+	out += '\n';
+
+	Position pos;
+	pos.setFEN(setup ? game.startFen() : Position::start_fen);
+	int number = pos.fullmoveNumber();
+	bool white = pos.sideToMove() == Color::WHITE;
+	// Tokens are never split, lines are wrapped before one would pass 80 columns
+	size_t line_start = out.size();
+	auto token = [&](std::string_view word) {
+		if (out.size() > line_start && out.size() - line_start + word.size() + 1 > 80) {
+			out += '\n';
+			line_start = out.size();
+		} else if (out.size() > line_start) {
+			out += ' ';
+		}
+		out += word;
+	};
+
+	const std::vector<std::string>& moves = game.moves();
+	bool commented = comments.size() == moves.size();
+	for (size_t i = 0; i < moves.size(); i++) {
+		Move m = pos.parseMove(moves[i]);
+		// Numbers stay on the line of their move
+		if (white)
+			token(std::format("{}. {}", number, toSan(pos, m)));
+		else if (i == 0)
+			token(std::format("{}... {}", number, toSan(pos, m)));
+		else
+			token(toSan(pos, m));
+		if (commented && !comments[i].empty()) {
+			// Nothing escapes a brace inside a comment
+			std::string comment = comments[i];
+			std::erase(comment, '}');
+			token("{" + comment + "}");
+		}
+		pos.makeMove(m);
+		if (!white)
+			number++;
+		white = !white;
+	}
+	token(toString(game.outcome()));
+	out += "\n\n";
+}
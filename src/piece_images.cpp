@@ -0,0 +1,176 @@
+#include "piece_images.hpp"
+
+#include <SDL3/SDL.h>
+#include <SDL3_image/SDL_image.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <thread>
+
+namespace {
+
+// FNV-1a: only has to notice that an SVG changed, and is the same on every run
+uint64_t hashBytes(const std::string& data) {
+	uint64_t hash = 0xcbf29ce484222325;
+	for (char c : data) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+bool readFile(const std::string& path, std::string& data) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+// A cached blob is the bare pixels; its name holds everything else
+bool readBlob(const std::string& path, size_t bytes, std::vector<uint8_t>& pixels) {
+	FILE* file = std::fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	pixels.resize(bytes);
+	bool ok = std::fread(pixels.data(), 1, bytes, file) == bytes && std::fgetc(file) == EOF;
+	std::fclose(file);
+	if (!ok)
+		pixels.clear();
+	return ok;
+}
+
+// Written under a temporary name and renamed, so a second instance never reads half a file
+void writeBlob(const std::string& path, const std::vector<uint8_t>& pixels) {
+	std::string tmp = std::format(
+			"{}.{}.tmp", path, std::hash<std::thread::id>{}(std::this_thread::get_id()));
+	FILE* file = std::fopen(tmp.c_str(), "wb");
+	if (!file)
+		return;
+	bool ok = std::fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+	ok = std::fclose(file) == 0 && ok;
+	std::error_code ec;
+	if (ok)
+		std::filesystem::rename(tmp, path, ec);
+	if (!ok || ec)
+		std::filesystem::remove(tmp, ec);
+}
+
+// Decodes the image at exactly size x size, as tightly packed RGBA
+std::vector<uint8_t> rasterize(const std::string& data, int size) {
+	SDL_Surface* image = nullptr;
+	if (SDL_IOStream* io = SDL_IOFromConstMem(data.data(), data.size())) {
+		image = IMG_LoadSizedSVG_IO(io, size, size);
+		SDL_CloseIO(io);
+	}
+	// Not an SVG after all: whatever else SDL_image reads, scaled below
+	if (!image) {
+		if (SDL_IOStream* io = SDL_IOFromConstMem(data.data(), data.size()))
+			image = IMG_Load_IO(io, true);
+	}
+	if (!image)
+		return {};
+
+	std::vector<uint8_t> pixels;
+	SDL_Surface* rgba = SDL_CreateSurface(size, size, SDL_PIXELFORMAT_RGBA32);
+	// Copied rather than blended onto the transparent surface, which would darken the edges
+	SDL_SetSurfaceBlendMode(image, SDL_BLENDMODE_NONE);
+	if (rgba && SDL_BlitSurfaceScaled(image, nullptr, rgba, nullptr, SDL_SCALEMODE_LINEAR)) {
+		size_t row = static_cast<size_t>(size) * 4;
+		pixels.resize(row * static_cast<size_t>(size));
+		for (int y = 0; y < size; y++) {
+			std::memcpy(pixels.data() + row * static_cast<size_t>(y),
+					static_cast<const uint8_t*>(rgba->pixels) + rgba->pitch * y, row);
+		}
+	}
+	SDL_DestroySurface(rgba);
+	SDL_DestroySurface(image);
+	return pixels;
+}
+
+} // namespace
+
+PieceImages::PieceImages(std::string svg_directory, std::string blob_directory)
+	: directory(std::move(svg_directory))
+	, cache_directory(std::move(blob_directory)) {
+}
+
+PieceImages::~PieceImages() {
+	shutdown();
+}
+
+void PieceImages::request(int size, std::function<void()> done) {
+	if (!pool) {
+		std::error_code ec;
+		std::filesystem::create_directories(cache_directory, ec);
+		pool = std::make_unique<ThreadPool>(std::clamp<size_t>(
+				std::thread::hardware_concurrency(), 1, static_cast<size_t>(no_piece)));
+	}
+
+	in_flight = std::make_unique<PieceBitmaps>();
+	in_flight->size = size;
+	remaining = no_piece;
+	auto start = std::chrono::steady_clock::now();
+	for (PieceCode piece = 0; piece < no_piece; piece++) {
+		pool->submit([this, bitmaps = in_flight.get(), piece, start, done] {
+			load(*bitmaps, piece);
+			if (remaining.fetch_sub(1) != 1)
+				return;
+			bitmaps->time_ms = std::chrono::duration<double, std::milli>(
+					std::chrono::steady_clock::now() - start)
+							   .count();
+			finished.store(true, std::memory_order_release);
+			if (done)
+				done();
+		});
+	}
+}
+
+std::unique_ptr<PieceBitmaps> PieceImages::takeFinished() {
+	if (!finished.exchange(false, std::memory_order_acquire))
+		return nullptr;
+	return std::move(in_flight);
+}
+
+void PieceImages::shutdown() {
+	if (!pool)
+		return;
+	pool->wait();
+	pool.reset();
+}
+
+void PieceImages::load(PieceBitmaps& bitmaps, PieceCode piece) const {
+	char letter = static_cast<char>(std::toupper(pieceToChar(piece)));
+	std::string name = std::format("{}{}", colorOf(piece) == Color::WHITE ? 'w' : 'b', letter);
+	std::string path = std::format("{}/{}.svg", directory, name);
+	std::string data;
+	// Workers report straight to stderr; the piece is drawn as a plain square instead
+	if (!readFile(path, data)) {
+		std::println(stderr, "piece image {} is missing", path);
+		return;
+	}
+
+	int size = bitmaps.size;
+	std::vector<uint8_t>& pixels = bitmaps.pixels[piece];
+	std::string blob = std::format(
+			"{}/{}-{}-{:016x}.rgba", cache_directory, name, size, hashBytes(data));
+	size_t bytes = static_cast<size_t>(size) * static_cast<size_t>(size) * 4;
+	if (readBlob(blob, bytes, pixels)) {
+		// Pieces of one batch finish on different workers
+		std::atomic_ref(bitmaps.cache_hits).fetch_add(1);
+		return;
+	}
+	pixels = rasterize(data, size);
+	if (pixels.empty())
+		std::println(stderr, "could not rasterize piece image {}", path);
+	else
+		writeBlob(blob, pixels);
+}
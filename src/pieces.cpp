@@ -5,16 +5,27 @@
 #include "bishop.hpp"
 #include "queen.hpp"
 #include "king.hpp"
+#include "move.hpp"
+#include "position.hpp"
 
-bool isValid(int x, int y) {
-	return x >= 0 && x < 8 && y >= 0 && y < 8;
+namespace {
+
+// Splits attacked squares into captures and quiet moves; `targets` must exclude own pieces
+void addMoves(const Position& board, int from, Bitboard targets, MoveList& moves) {
+	Bitboard captures = targets & board.occupied();
+	Bitboard quiets = targets & ~board.occupied();
+	while (captures)
+		moves.push_back(Move(from, popLsb(captures), Move::CAPTURE));
+	while (quiets)
+		moves.push_back(Move(from, popLsb(quiets)));
 }
 
+} // namespace
+
 // --- Pawn ---
 Pawn::Pawn(Color c, BoardCoordinates pos)
 	: position(pos)
-	, color(c)
-	, has_moved(false) {
+	, color(c) {
 }
 Color Pawn::getColor() const {
 	return color;
@@ -27,49 +38,44 @@ BoardCoordinates Pawn::getPosition() const {
 }
 void Pawn::setPosition(BoardCoordinates new_pos) {
 	position = new_pos;
-	has_moved = true;
 }
-bool Pawn::hasMoved() const {
-	return has_moved;
-}
-
-std::vector<BoardCoordinates> Pawn::getPossibleMoves(const BoardArray& board) const {
-	std::vector<BoardCoordinates> moves;
-	int direction = (color == Color::WHITE) ? -1 : 1;
-	int forward_y = position.y + direction;
 
-	if (isValid(position.x, forward_y)) {
-		int idx = forward_y * 8 + position.x;
-		if (board[idx] == nullptr) {
-			moves.push_back({position.x, (int8_t)forward_y});
-			bool is_start = (color == Color::WHITE && position.y == 6) ||
-					(color == Color::BLACK && position.y == 1);
-			if (is_start) {
-				int forward2_y = position.y + (direction * 2);
-				if (isValid(position.x, forward2_y) &&
-						board[forward2_y * 8 + position.x] == nullptr) {
-					moves.push_back({position.x, (int8_t)forward2_y});
-				}
-			}
-		}
-	}
-	int captureX[] = {position.x - 1, position.x + 1};
-	for (int cx : captureX) {
-		if (isValid(cx, forward_y)) {
-			int idx = forward_y * 8 + cx;
-			if (board[idx] != nullptr && board[idx]->getColor() != color) {
-				moves.push_back({(int8_t)cx, (int8_t)forward_y});
-			}
+void Pawn::getPossibleMoves(const Position& board, MoveList& moves) const {
+	int from = toSquare(position);
+	int forward = (color == Color::WHITE) ? -8 : 8;
+	bool promotes = (from + forward) / 8 == 0 || (from + forward) / 8 == 7;
+	auto add = [&](int to, uint8_t flags) {
+		if (!promotes) {
+			moves.push_back(Move(from, to, flags));
+			return;
 		}
+		uint8_t capture = flags & Move::CAPTURE;
+		moves.push_back(Move(from, to, Move::PROMO_QUEEN | capture));
+		moves.push_back(Move(from, to, Move::PROMO_ROOK | capture));
+		moves.push_back(Move(from, to, Move::PROMO_BISHOP | capture));
+		moves.push_back(Move(from, to, Move::PROMO_KNIGHT | capture));
+	};
+
+	if (board.isEmpty(from + forward)) {
+		add(from + forward, Move::QUIET);
+		bool is_start = (color == Color::WHITE && position.y == 6) ||
+				(color == Color::BLACK && position.y == 1);
+		if (is_start && board.isEmpty(from + 2 * forward))
+			moves.push_back(Move(from, from + 2 * forward, Move::DOUBLE_PUSH));
 	}
-	return moves;
+
+	Bitboard attacks = pawn_attacks[static_cast<int>(color)][from];
+	Bitboard captures = attacks & board.pieces(~color);
+	while (captures)
+		add(popLsb(captures), Move::CAPTURE);
+	if (board.epSquare() != -1 && (attacks & squareBB(board.epSquare())))
+		moves.push_back(Move(from, board.epSquare(), Move::EP_CAPTURE));
 }
 
 // --- Rook ---
 Rook::Rook(Color c, BoardCoordinates pos)
 	: position(pos)
-	, color(c)
-	, has_moved(false) {
+	, color(c) {
 }
 Color Rook::getColor() const {
 	return color;
@@ -82,32 +88,11 @@ BoardCoordinates Rook::getPosition() const {
 }
 void Rook::setPosition(BoardCoordinates new_pos) {
 	position = new_pos;
-	has_moved = true;
-}
-bool Rook::hasMoved() const {
-	return has_moved;
 }
 
-std::vector<BoardCoordinates> Rook::getPossibleMoves(const BoardArray& board) const {
-	std::vector<BoardCoordinates> moves;
-	int directions[4][2] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}};
-	for (auto& dir : directions) {
-		for (int i = 1; i < 8; i++) {
-			int nx = position.x + dir[0] * i;
-			int ny = position.y + dir[1] * i;
-			if (!isValid(nx, ny))
-				break;
-			int idx = ny * 8 + nx;
-			if (board[idx] == nullptr) {
-				moves.push_back({(int8_t)nx, (int8_t)ny});
-			} else {
-				if (board[idx]->getColor() != color)
-					moves.push_back({(int8_t)nx, (int8_t)ny});
-				break;
-			}
-		}
-	}
-	return moves;
+void Rook::getPossibleMoves(const Position& board, MoveList& moves) const {
+	int from = toSquare(position);
+	addMoves(board, from, rookAttacks(from, board.occupied()) & ~board.pieces(color), moves);
 }
 
 // --- Knight ---
@@ -128,20 +113,9 @@ void Knight::setPosition(BoardCoordinates new_pos) {
 	position = new_pos;
 }
 
-std::vector<BoardCoordinates> Knight::getPossibleMoves(const BoardArray& board) const {
-	std::vector<BoardCoordinates> moves;
-	int offsets[8][2] = {{1, 2}, {1, -2}, {-1, 2}, {-1, -2}, {2, 1}, {2, -1}, {-2, 1}, {-2, -1}};
-	for (auto& off : offsets) {
-		int nx = position.x + off[0];
-		int ny = position.y + off[1];
-		if (isValid(nx, ny)) {
-			int idx = ny * 8 + nx;
-			if (board[idx] == nullptr || board[idx]->getColor() != color) {
-				moves.push_back({(int8_t)nx, (int8_t)ny});
-			}
-		}
-	}
-	return moves;
+void Knight::getPossibleMoves(const Position& board, MoveList& moves) const {
+	int from = toSquare(position);
+	addMoves(board, from, knight_attacks[from] & ~board.pieces(color), moves);
 }
 
 // --- Bishop ---
@@ -162,26 +136,9 @@ void Bishop::setPosition(BoardCoordinates new_pos) {
 	position = new_pos;
 }
 
-std::vector<BoardCoordinates> Bishop::getPossibleMoves(const BoardArray& board) const {
-	std::vector<BoardCoordinates> moves;
-	int directions[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
-	for (auto& dir : directions) {
-		for (int i = 1; i < 8; i++) {
-			int nx = position.x + dir[0] * i;
-			int ny = position.y + dir[1] * i;
-			if (!isValid(nx, ny))
-				break;
-			int idx = ny * 8 + nx;
-			if (board[idx] == nullptr) {
-				moves.push_back({(int8_t)nx, (int8_t)ny});
-			} else {
-				if (board[idx]->getColor() != color)
-					moves.push_back({(int8_t)nx, (int8_t)ny});
-				break;
-			}
-		}
-	}
-	return moves;
+void Bishop::getPossibleMoves(const Position& board, MoveList& moves) const {
+	int from = toSquare(position);
+	addMoves(board, from, bishopAttacks(from, board.occupied()) & ~board.pieces(color), moves);
 }
 
 // --- Queen ---
@@ -202,33 +159,15 @@ void Queen::setPosition(BoardCoordinates new_pos) {
 	position = new_pos;
 }
 
-std::vector<BoardCoordinates> Queen::getPossibleMoves(const BoardArray& board) const {
-	std::vector<BoardCoordinates> moves;
-	int directions[8][2] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
-	for (auto& dir : directions) {
-		for (int i = 1; i < 8; i++) {
-			int nx = position.x + dir[0] * i;
-			int ny = position.y + dir[1] * i;
-			if (!isValid(nx, ny))
-				break;
-			int idx = ny * 8 + nx;
-			if (board[idx] == nullptr) {
-				moves.push_back({(int8_t)nx, (int8_t)ny});
-			} else {
-				if (board[idx]->getColor() != color)
-					moves.push_back({(int8_t)nx, (int8_t)ny});
-				break;
-			}
-		}
-	}
-	return moves;
+void Queen::getPossibleMoves(const Position& board, MoveList& moves) const {
+	int from = toSquare(position);
+	addMoves(board, from, queenAttacks(from, board.occupied()) & ~board.pieces(color), moves);
 }
 
 // --- King ---
 King::King(Color c, BoardCoordinates pos)
 	: position(pos)
 	, color(c)
-	, has_moved(false)
 	, in_check(false) {
 }
 Color King::getColor() const {
@@ -242,47 +181,58 @@ BoardCoordinates King::getPosition() const {
 }
 void King::setPosition(BoardCoordinates new_pos) {
 	position = new_pos;
-	has_moved = true;
-}
-bool King::hasMoved() const {
-	return has_moved;
 }
 
-std::vector<BoardCoordinates> King::getPossibleMoves(const BoardArray& board) const {
-	std::vector<BoardCoordinates> moves;
-	for (int x = -1; x <= 1; x++) {
-		for (int y = -1; y <= 1; y++) {
-			if (x == 0 && y == 0)
-				continue;
-			int nx = position.x + x;
-			int ny = position.y + y;
-			if (isValid(nx, ny)) {
-				int idx = ny * 8 + nx;
-				if (board[idx] == nullptr || board[idx]->getColor() != color) {
-					moves.push_back({(int8_t)nx, (int8_t)ny});
-				}
-			}
-		}
-	}
+void King::getPossibleMoves(const Position& board, MoveList& moves) const {
+	int from = toSquare(position);
+	addMoves(board, from, king_attacks[from] & ~board.pieces(color), moves);
 
 	// CASTLING
-	if (!has_moved) {
-		int rook_k = position.y * 8 + 7;
-		bool k_clear =
-				(board[position.y * 8 + 5] == nullptr && board[position.y * 8 + 6] == nullptr);
-		if (k_clear && board[rook_k] != nullptr && !board[rook_k]->hasMoved() &&
-				board[rook_k]->getColor() == color) {
-			moves.push_back({(int8_t)(position.x + 2), position.y});
-		}
-
-		int rook_q = position.y * 8 + 0;
-		bool q_clear = (board[position.y * 8 + 1] == nullptr &&
-				board[position.y * 8 + 2] == nullptr && board[position.y * 8 + 3] == nullptr);
-		if (q_clear && board[rook_q] != nullptr && !board[rook_q]->hasMoved() &&
-				board[rook_q]->getColor() == color) {
-			moves.push_back({(int8_t)(position.x - 2), position.y});
-		}
+	// The king may not castle out of or through check; landing in check is left to the
+	// caller like any other king move
+	Color enemy = ~color;
+	CastlingRight kingside = color == Color::WHITE ? WHITE_OO : BLACK_OO;
+	CastlingRight queenside = color == Color::WHITE ? WHITE_OOO : BLACK_OOO;
+	int row = position.y * 8;
+	if (!(board.canCastle(kingside) || board.canCastle(queenside)) ||
+			board.isAttacked(from, enemy))
+		return;
+	if (board.canCastle(kingside) && board.isEmpty(row + 5) && board.isEmpty(row + 6) &&
+			!board.isAttacked(from + 1, enemy)) {
+		moves.push_back(Move(from, from + 2, Move::KING_CASTLE));
+	}
+	if (board.canCastle(queenside) && board.isEmpty(row + 1) && board.isEmpty(row + 2) &&
+			board.isEmpty(row + 3) && !board.isAttacked(from - 1, enemy)) {
+		moves.push_back(Move(from, from - 2, Move::QUEEN_CASTLE));
 	}
+}
 
-	return moves;
-}
\ No newline at end of file
+void getPieceMoves(const Position& board, int sq, MoveList& moves) {
+	if (board.isEmpty(sq))
+		return;
+	PieceCode p = board.pieceAt(sq);
+	Color c = colorOf(p);
+	BoardCoordinates pos = toCoordinates(sq);
+	switch (typeOf(p)) {
+	case PieceType::PAWN:
+		Pawn(c, pos).getPossibleMoves(board, moves);
+		break;
+	case PieceType::ROOK:
+		Rook(c, pos).getPossibleMoves(board, moves);
+		break;
+	case PieceType::KNIGHT:
+		Knight(c, pos).getPossibleMoves(board, moves);
+		break;
+	case PieceType::BISHOP:
+		Bishop(c, pos).getPossibleMoves(board, moves);
+		break;
+	case PieceType::QUEEN:
+		Queen(c, pos).getPossibleMoves(board, moves);
+		break;
+	case PieceType::KING:
+		King(c, pos).getPossibleMoves(board, moves);
+		break;
+	default:
+		break;
+	}
+}
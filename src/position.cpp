@@ -0,0 +1,405 @@
+#include "position.hpp"
+
+#include <charconv>
+#include <cstdlib>
+#include <print>
+#include <utility>
+
+namespace {
+
+constexpr std::string_view piece_chars{"PRNBQKprnbqk"};
+
+// Rights that survive a move touching each square; a king or rook leaving (or a rook being
+// captured on) its home square clears the matching bits
+constexpr std::array<uint8_t, 64> castling_mask = [] {
+	std::array<uint8_t, 64> mask{};
+	mask.fill(WHITE_OO | WHITE_OOO | BLACK_OO | BLACK_OOO);
+	mask[0] &= ~BLACK_OOO;
+	mask[4] &= ~(BLACK_OO | BLACK_OOO);
+	mask[7] &= ~BLACK_OO;
+	mask[56] &= ~WHITE_OOO;
+	mask[60] &= ~(WHITE_OO | WHITE_OOO);
+	mask[63] &= ~WHITE_OO;
+	return mask;
+}();
+
+struct ZobristKeys {
+	std::array<std::array<uint64_t, 64>, 12> pieces;
+	std::array<uint64_t, 16> castling;
+	std::array<uint64_t, 8> ep_file;
+	uint64_t side;
+};
+
+// Generated at compile time from a fixed xorshift64* seed so keys are stable between builds
+constexpr ZobristKeys zobrist = [] {
+	ZobristKeys keys{};
+	uint64_t state = 0x2545F4914F6CDD1DULL;
+	auto next = [&state] {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 2685821657736338717ULL;
+	};
+	for (auto& piece : keys.pieces) {
+		for (auto& key : piece)
+			key = next();
+	}
+	for (auto& key : keys.castling)
+		key = next();
+	for (auto& key : keys.ep_file)
+		key = next();
+	keys.side = next();
+	return keys;
+}();
+
+std::string_view nextField(std::string_view& s) {
+	while (!s.empty() && s.front() == ' ')
+		s.remove_prefix(1);
+	size_t end = s.find(' ');
+	std::string_view field = s.substr(0, end);
+	s.remove_prefix(end == std::string_view::npos ? s.size() : end);
+	return field;
+}
+
+} // namespace
+
+char pieceToChar(PieceCode p) {
+	return p == no_piece ? ' ' : piece_chars[p];
+}
+
+std::string squareToString(int sq) {
+	char file = 'a' + sq % 8;
+	char rank = '8' - sq / 8;
+	return std::string{file, rank};
+}
+
+Position::Position() {
+	setFEN(start_fen);
+}
+
+void Position::clear() {
+	type_bb.fill(0);
+	color_bb.fill(0);
+	occupied_bb = 0;
+	mailbox.fill(no_piece);
+	side_to_move = Color::WHITE;
+	castling = 0;
+	ep_square = -1;
+	halfmove_clock = 0;
+	fullmove_number = 1;
+	zobrist_key = 0;
+}
+
+uint64_t Position::computeKey() const {
+	uint64_t key = 0;
+	Bitboard occupied = occupied_bb;
+	while (occupied) {
+		int sq = popLsb(occupied);
+		key ^= zobrist.pieces[mailbox[sq]][sq];
+	}
+	key ^= zobrist.castling[castling];
+	if (ep_square != -1)
+		key ^= zobrist.ep_file[ep_square % 8];
+	if (side_to_move == Color::BLACK)
+		key ^= zobrist.side;
+	return key;
+}
+
+// Built with -Dhash_check=true, every make/unmake compares the incremental key against one
+// recomputed from scratch
+void Position::verifyKey() const {
+#ifdef HASH_CHECK
+	uint64_t expected = computeKey();
+	if (zobrist_key != expected) {
+		std::println(stderr, "Zobrist key mismatch in {}: {:016x} != {:016x}", fen(),
+				zobrist_key, expected);
+		std::abort();
+	}
+#endif
+}
+
+bool Position::setFEN(std::string_view fen) {
+	clear();
+
+	std::string_view placement = nextField(fen);
+	int sq = 0;
+	for (char c : placement) {
+		if (c == '/')
+			continue;
+		if (c >= '1' && c <= '8') {
+			sq += c - '0';
+			continue;
+		}
+		size_t idx = piece_chars.find(c);
+		if (idx == std::string_view::npos || sq >= 64)
+			return false;
+		putPiece(static_cast<PieceCode>(idx), sq++);
+	}
+	if (sq != 64 || popCount(pieces(Color::WHITE, PieceType::KING)) != 1 ||
+			popCount(pieces(Color::BLACK, PieceType::KING)) != 1)
+		return false;
+
+	std::string_view side = nextField(fen);
+	if (side != "w" && side != "b")
+		return false;
+	side_to_move = side == "w" ? Color::WHITE : Color::BLACK;
+
+	for (char c : nextField(fen)) {
+		switch (c) {
+		case 'K':
+			castling |= WHITE_OO;
+			break;
+		case 'Q':
+			castling |= WHITE_OOO;
+			break;
+		case 'k':
+			castling |= BLACK_OO;
+			break;
+		case 'q':
+			castling |= BLACK_OOO;
+			break;
+		default:
+			break;
+		}
+	}
+	// Like the en passant square, a right whose king or rook has left home cannot be used
+	constexpr std::pair<int, PieceCode> homes[] = {
+		{0, makePieceCode(Color::BLACK, PieceType::ROOK)},
+		{4, makePieceCode(Color::BLACK, PieceType::KING)},
+		{7, makePieceCode(Color::BLACK, PieceType::ROOK)},
+		{56, makePieceCode(Color::WHITE, PieceType::ROOK)},
+		{60, makePieceCode(Color::WHITE, PieceType::KING)},
+		{63, makePieceCode(Color::WHITE, PieceType::ROOK)},
+	};
+	for (auto [home, piece] : homes) {
+		if (pieceAt(home) != piece)
+			castling &= castling_mask[home];
+	}
+
+	std::string_view ep = nextField(fen);
+	if (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h' && ep[1] >= '1' && ep[1] <= '8') {
+		// Many writers give the square after every double push; keep it only if it matters
+		int ep_sq = ('8' - ep[1]) * 8 + (ep[0] - 'a');
+		if (canTakeEnPassant(side_to_move, ep_sq))
+			ep_square = static_cast<int8_t>(ep_sq);
+	}
+
+	// The move counters are optional, EPD lines leave them out
+	std::string_view halfmove = nextField(fen);
+	std::from_chars(halfmove.data(), halfmove.data() + halfmove.size(), halfmove_clock);
+	std::string_view fullmove = nextField(fen);
+	std::from_chars(fullmove.data(), fullmove.data() + fullmove.size(), fullmove_number);
+	zobrist_key = computeKey();
+	return true;
+}
+
+std::string Position::fen() const {
+	std::string fen;
+	for (int y = 0; y < 8; y++) {
+		int empty = 0;
+		for (int x = 0; x < 8; x++) {
+			PieceCode p = mailbox[y * 8 + x];
+			if (p == no_piece)
+				empty++;
+			else {
+				if (empty > 0) {
+					fen += std::to_string(empty);
+					empty = 0;
+				}
+				fen += pieceToChar(p);
+			}
+		}
+		if (empty > 0)
+			fen += std::to_string(empty);
+		if (y < 7)
+			fen += "/";
+	}
+	fen += (side_to_move == Color::WHITE ? " w " : " b ");
+
+	std::string rights;
+	if (castling & WHITE_OO)
+		rights += "K";
+	if (castling & WHITE_OOO)
+		rights += "Q";
+	if (castling & BLACK_OO)
+		rights += "k";
+	if (castling & BLACK_OOO)
+		rights += "q";
+	fen += rights.empty() ? "-" : rights;
+
+	fen += " " + (ep_square != -1 ? squareToString(ep_square) : std::string{"-"});
+	fen += " " + std::to_string(halfmove_clock) + " " + std::to_string(fullmove_number);
+	return fen;
+}
+
+Bitboard Position::attackersTo(int sq, Bitboard occupied) const {
+	Bitboard diagonal = pieces(PieceType::BISHOP) | pieces(PieceType::QUEEN);
+	Bitboard straight = pieces(PieceType::ROOK) | pieces(PieceType::QUEEN);
+	Bitboard white_pawns = pieces(Color::WHITE, PieceType::PAWN);
+	Bitboard black_pawns = pieces(Color::BLACK, PieceType::PAWN);
+	// A pawn attacks `sq` exactly when a pawn of the other colour on `sq` would attack it
+	return (pawn_attacks[static_cast<int>(Color::BLACK)][sq] & white_pawns) |
+			(pawn_attacks[static_cast<int>(Color::WHITE)][sq] & black_pawns) |
+			(knight_attacks[sq] & pieces(PieceType::KNIGHT)) |
+			(king_attacks[sq] & pieces(PieceType::KING)) |
+			(bishopAttacks(sq, occupied) & diagonal) | (rookAttacks(sq, occupied) & straight);
+}
+
+bool Position::isAttacked(int sq, Color by) const {
+	if (pawn_attacks[static_cast<int>(~by)][sq] & pieces(by, PieceType::PAWN))
+		return true;
+	if (knight_attacks[sq] & pieces(by, PieceType::KNIGHT))
+		return true;
+	if (king_attacks[sq] & pieces(by, PieceType::KING))
+		return true;
+	Bitboard queens = pieces(by, PieceType::QUEEN);
+	if (bishopAttacks(sq, occupied_bb) & (pieces(by, PieceType::BISHOP) | queens))
+		return true;
+	return rookAttacks(sq, occupied_bb) & (pieces(by, PieceType::ROOK) | queens);
+}
+
+void Position::putPiece(PieceCode p, int sq) {
+	Bitboard b = squareBB(sq);
+	type_bb[static_cast<int>(typeOf(p))] |= b;
+	color_bb[static_cast<int>(colorOf(p))] |= b;
+	occupied_bb |= b;
+	mailbox[sq] = p;
+	zobrist_key ^= zobrist.pieces[p][sq];
+}
+
+void Position::removePiece(int sq) {
+	PieceCode p = mailbox[sq];
+	Bitboard b = squareBB(sq);
+	type_bb[static_cast<int>(typeOf(p))] &= ~b;
+	color_bb[static_cast<int>(colorOf(p))] &= ~b;
+	occupied_bb &= ~b;
+	mailbox[sq] = no_piece;
+	zobrist_key ^= zobrist.pieces[p][sq];
+}
+
+void Position::movePiece(int from, int to) {
+	PieceCode p = mailbox[from];
+	Bitboard b = squareBB(from) | squareBB(to);
+	type_bb[static_cast<int>(typeOf(p))] ^= b;
+	color_bb[static_cast<int>(colorOf(p))] ^= b;
+	occupied_bb ^= b;
+	mailbox[to] = p;
+	mailbox[from] = no_piece;
+	zobrist_key ^= zobrist.pieces[p][from] ^ zobrist.pieces[p][to];
+}
+
+UndoInfo Position::makeMove(Move m) {
+	int from = m.from();
+	int to = m.to();
+	bool is_pawn = typeOf(mailbox[from]) == PieceType::PAWN;
+	UndoInfo undo{zobrist_key, no_piece, castling, ep_square, halfmove_clock};
+
+	if (ep_square != -1)
+		zobrist_key ^= zobrist.ep_file[ep_square % 8];
+	zobrist_key ^= zobrist.castling[castling];
+
+	if (m.flags() == Move::EP_CAPTURE) {
+		// The captured pawn sits beside the moving one, on the rank it started from
+		int captured_sq = (from / 8) * 8 + to % 8;
+		undo.captured = mailbox[captured_sq];
+		removePiece(captured_sq);
+	} else if (m.isCapture()) {
+		undo.captured = mailbox[to];
+		removePiece(to);
+	}
+	movePiece(from, to);
+
+	if (m.flags() == Move::KING_CASTLE)
+		movePiece(to + 1, to - 1);
+	else if (m.flags() == Move::QUEEN_CASTLE)
+		movePiece(to - 2, to + 1);
+
+	if (m.isPromotion()) {
+		removePiece(to);
+		putPiece(makePieceCode(side_to_move, m.promotion()), to);
+	}
+
+	ep_square = -1;
+	if (m.flags() == Move::DOUBLE_PUSH && canTakeEnPassant(~side_to_move, (from + to) / 2))
+		ep_square = static_cast<int8_t>((from + to) / 2);
+	if (ep_square != -1)
+		zobrist_key ^= zobrist.ep_file[ep_square % 8];
+	castling &= castling_mask[from] & castling_mask[to];
+	zobrist_key ^= zobrist.castling[castling];
+	halfmove_clock = (is_pawn || m.isCapture()) ? 0 : halfmove_clock + 1;
+	if (side_to_move == Color::BLACK)
+		fullmove_number++;
+	side_to_move = ~side_to_move;
+	zobrist_key ^= zobrist.side;
+
+	verifyKey();
+	return undo;
+}
+
+void Position::undoMove(Move m, const UndoInfo& undo) {
+	int from = m.from();
+	int to = m.to();
+	side_to_move = ~side_to_move;
+	if (side_to_move == Color::BLACK)
+		fullmove_number--;
+
+	if (m.isPromotion()) {
+		removePiece(to);
+		putPiece(makePieceCode(side_to_move, PieceType::PAWN), to);
+	}
+
+	if (m.flags() == Move::KING_CASTLE)
+		movePiece(to - 1, to + 1);
+	else if (m.flags() == Move::QUEEN_CASTLE)
+		movePiece(to + 1, to - 2);
+
+	movePiece(to, from);
+	if (m.flags() == Move::EP_CAPTURE)
+		putPiece(undo.captured, (from / 8) * 8 + to % 8);
+	else if (m.isCapture())
+		putPiece(undo.captured, to);
+
+	castling = undo.castling;
+	ep_square = undo.ep_square;
+	halfmove_clock = undo.halfmove_clock;
+	// The piece helpers kept the key in step, but the saved one also restores the rights and
+	// en-passant terms without replaying them
+	zobrist_key = undo.key;
+
+	verifyKey();
+}
+
+Move Position::parseMove(std::string_view uci) const {
+	if (uci.size() < 4 || uci[0] < 'a' || uci[0] > 'h' || uci[1] < '1' || uci[1] > '8' ||
+			uci[2] < 'a' || uci[2] > 'h' || uci[3] < '1' || uci[3] > '8')
+		return Move::none();
+	int from = ('8' - uci[1]) * 8 + (uci[0] - 'a');
+	int to = ('8' - uci[3]) * 8 + (uci[2] - 'a');
+	PieceCode p = mailbox[from];
+	if (p == no_piece || colorOf(p) != side_to_move)
+		return Move::none();
+
+	uint8_t flags = isEmpty(to) ? Move::QUIET : Move::CAPTURE;
+	PieceType type = typeOf(p);
+	if (type == PieceType::PAWN) {
+		if (to == ep_square)
+			flags = Move::EP_CAPTURE;
+		else if (std::abs(to - from) == 16)
+			flags = Move::DOUBLE_PUSH;
+		if (to / 8 == 0 || to / 8 == 7) {
+			// Promotion flags are ordered like "nbrq", a missing suffix means queen
+			size_t kind = std::string_view{"nbrq"}.find(uci.size() > 4 ? uci[4] : 'q');
+			flags |= Move::PROMO_KNIGHT | (kind == std::string_view::npos ? 3 : kind);
+		}
+	} else if (type == PieceType::KING && std::abs(to - from) == 2) {
+		flags = to > from ? Move::KING_CASTLE : Move::QUEEN_CASTLE;
+	}
+	return Move(from, to, flags);
+}
+
+std::string Move::toUci() const {
+	std::string uci = squareToString(from()) + squareToString(to());
+	if (isPromotion())
+		uci += "nbrq"[flags() & 3];
+	return uci;
+}
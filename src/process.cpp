@@ -0,0 +1,132 @@
+#include "process.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+namespace {
+
+// How long a child gets to exit on its own once its pipes are closed
+constexpr int exit_grace_ms{500};
+
+// True once the child has exited, false if it is still running after `timeout_ms`
+bool waitForExit(int pid, int timeout_ms) {
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	int pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+	if (pidfd >= 0) {
+		pollfd exited{pidfd, POLLIN, 0};
+		int ready;
+		do
+			ready = poll(&exited, 1, timeout_ms);
+		while (ready < 0 && errno == EINTR);
+		close(pidfd);
+		if (ready >= 0)
+			return ready > 0;
+		// Any other poll error says nothing about the child: fall back to looking for it
+	}
+	// Kernels before 5.3 have no pidfd: look every millisecond. WNOWAIT leaves the child for the
+	// caller to reap.
+	while (true) {
+		siginfo_t info{};
+		if (waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOHANG | WNOWAIT) != 0 ||
+				info.si_pid == pid)
+			return true;
+		if (std::chrono::steady_clock::now() >= deadline)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+} // namespace
+
+bool spawnProcess(const std::string& path, ChildProcess& child, const ProcessLimits& limits) {
+	// Close-on-exec so the pipes of one engine never leak into the next one spawned
+	int in[2];
+	int out[2];
+	if (pipe2(in, O_CLOEXEC) < 0)
+		return false;
+	if (pipe2(out, O_CLOEXEC) < 0) {
+		close(in[0]);
+		close(in[1]);
+		return false;
+	}
+
+	// dup2 clears close-on-exec on the copies, so only these two survive the exec
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 34)
+	// Descriptors the GUI libraries opened without close-on-exec
+	posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+#endif
+#endif
+
+	// Unlike fork(), posix_spawn does not copy the page tables of the whole GUI
+	char* argv[] = {const_cast<char*>(path.c_str()), nullptr};
+	pid_t pid;
+	int error = posix_spawnp(&pid, path.c_str(), &actions, nullptr, argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	close(in[0]);
+	close(out[1]);
+	if (error != 0) {
+		close(in[1]);
+		close(out[0]);
+		return false;
+	}
+
+	fcntl(out[0], F_SETFL, fcntl(out[0], F_GETFL, 0) | O_NONBLOCK);
+	child = {pid, in[1], out[0]};
+	setProcessLimits(pid, limits);
+	return true;
+}
+
+bool setProcessLimits(int pid, const ProcessLimits& limits) {
+	if (limits.cpus.empty() && !limits.nice)
+		return true;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int cpu : limits.cpus)
+		CPU_SET(cpu, &set);
+
+	// Both are per thread on Linux; threads started later inherit them from their creator
+	bool ok = true;
+	std::error_code ec;
+	std::filesystem::path tasks = "/proc/" + std::to_string(pid) + "/task";
+	for (const auto& entry : std::filesystem::directory_iterator(tasks, ec)) {
+		std::string name = entry.path().filename();
+		int tid;
+		if (std::from_chars(name.data(), name.data() + name.size(), tid).ec != std::errc{})
+			continue;
+		if (!limits.cpus.empty())
+			ok &= sched_setaffinity(tid, sizeof(set), &set) == 0;
+		if (limits.nice)
+			ok &= setpriority(PRIO_PROCESS, static_cast<id_t>(tid), *limits.nice) == 0;
+	}
+	return ok && !ec;
+}
+
+void closeProcess(ChildProcess& child) {
+	if (child.pid < 0)
+		return;
+	close(child.stdin_fd);
+	close(child.stdout_fd);
+	// End of input makes an engine quit, but one stuck in a search may never read it
+	if (!waitForExit(child.pid, exit_grace_ms))
+		kill(child.pid, SIGKILL);
+	waitpid(child.pid, nullptr, 0);
+	child = {};
+}
@@ -0,0 +1,173 @@
+#include "result_cache.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace {
+
+constexpr char magic[8] = {'C', 'H', 'E', 'S', 'S', 'R', 'C', '1'};
+
+struct Header {
+	char magic[8];
+	uint64_t count;
+};
+
+} // namespace
+
+ResultCache::ResultCache(size_t max_entries)
+	: capacity(std::max<size_t>(max_entries, 1)) {
+}
+
+ResultCache::~ResultCache() {
+	unmap();
+}
+
+uint64_t ResultCache::packLimits(const SearchLimits& limits, uint32_t variant) {
+	return static_cast<uint64_t>(std::clamp(limits.depth, 0, 255)) |
+	       static_cast<uint64_t>(std::clamp(limits.movetime_ms, 0, 0x7FFFFFFF)) << 8 |
+	       static_cast<uint64_t>(variant & 0xFFFFFF) << 40;
+}
+
+bool ResultCache::lookup(
+		uint64_t position, const SearchLimits& limits, uint32_t variant, CachedResult& result) {
+	uint64_t packed = packLimits(limits, variant);
+	const Record* record = nullptr;
+	if (auto it = index.find({position, packed}); it != index.end()) {
+		entries.splice(entries.begin(), entries, it->second);
+		record = &*it->second;
+	} else if (const Record* found = findMapped(position, packed)) {
+		insert(*found);
+		record = &entries.front();
+	}
+	if (!record) {
+		miss_count++;
+		return false;
+	}
+
+	hit_count++;
+	result.best_move.length = std::min<uint8_t>(record->move_length, 5);
+	std::memcpy(result.best_move.text.data(), record->move, result.best_move.length);
+	result.score = record->score;
+	result.mate = record->mate;
+	result.depth = record->depth;
+	return true;
+}
+
+void ResultCache::store(uint64_t position, const SearchLimits& limits, uint32_t variant,
+		const CachedResult& result) {
+	Record record{};
+	record.position = position;
+	record.limits = packLimits(limits, variant);
+	record.score = result.score;
+	record.depth = static_cast<uint8_t>(std::clamp(result.depth, 0, 255));
+	record.mate = result.mate;
+	record.move_length = result.best_move.length;
+	std::memcpy(record.move, result.best_move.text.data(), sizeof(record.move));
+	insert(record);
+}
+
+void ResultCache::insert(const Record& record) {
+	if (auto it = index.find({record.position, record.limits}); it != index.end()) {
+		*it->second = record;
+		entries.splice(entries.begin(), entries, it->second);
+		return;
+	}
+	if (entries.size() >= capacity) {
+		index.erase({entries.back().position, entries.back().limits});
+		entries.pop_back();
+	}
+	entries.push_front(record);
+	index[{record.position, record.limits}] = entries.begin();
+}
+
+const ResultCache::Record* ResultCache::findMapped(uint64_t position, uint64_t limits) const {
+	const Record* end = mapped + mapped_count;
+	const Record* it = std::lower_bound(mapped, end, std::pair{position, limits},
+			[](const Record& r, const std::pair<uint64_t, uint64_t>& key) {
+				return std::pair{r.position, r.limits} < key;
+			});
+	if (it != end && it->position == position && it->limits == limits)
+		return it;
+	return nullptr;
+}
+
+bool ResultCache::open(const std::string& path) {
+	unmap();
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+		::close(fd);
+		return false;
+	}
+	size_t size = static_cast<size_t>(st.st_size);
+	void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file alive on its own
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	// Divided rather than multiplied: a corrupt count times the record size could wrap around
+	// and pass, leaving lookups to read past the mapping
+	const Header* header = static_cast<const Header*>(data);
+	size_t body = size - sizeof(Header);
+	if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 || body % sizeof(Record) != 0 ||
+			header->count != body / sizeof(Record)) {
+		munmap(data, size);
+		return false;
+	}
+	mapping = data;
+	mapping_size = size;
+	mapped = reinterpret_cast<const Record*>(static_cast<const char*>(data) + sizeof(Header));
+	mapped_count = header->count;
+	return true;
+}
+
+bool ResultCache::save(const std::string& path) const {
+	// Recent answers first, then whatever of the file was not used again
+	std::vector<Record> records(entries.begin(), entries.end());
+	for (size_t i = 0; i < mapped_count && records.size() < capacity; i++) {
+		if (!index.contains({mapped[i].position, mapped[i].limits}))
+			records.push_back(mapped[i]);
+	}
+	std::sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+		return std::pair{a.position, a.limits} < std::pair{b.position, b.limits};
+	});
+
+	std::string tmp = path + ".tmp";
+	FILE* file = std::fopen(tmp.c_str(), "wb");
+	if (!file)
+		return false;
+	Header header{};
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.count = records.size();
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		  std::fwrite(records.data(), sizeof(Record), records.size(), file) == records.size();
+	ok &= std::fclose(file) == 0;
+	std::error_code ec;
+	if (ok)
+		std::filesystem::rename(tmp, path, ec);
+	if (!ok || ec) {
+		std::filesystem::remove(tmp, ec);
+		return false;
+	}
+	return true;
+}
+
+void ResultCache::unmap() {
+	if (mapping)
+		munmap(mapping, mapping_size);
+	mapping = nullptr;
+	mapping_size = 0;
+	mapped = nullptr;
+	mapped_count = 0;
+}
@@ -0,0 +1,148 @@
+#include "san.hpp"
+#include "movegen.hpp"
+
+namespace {
+
+bool isFile(char c) {
+	return c >= 'a' && c <= 'h';
+}
+
+bool isRank(char c) {
+	return c >= '1' && c <= '8';
+}
+
+bool pieceFromLetter(char c, PieceType& type) {
+	switch (c) {
+	case 'N':
+		type = PieceType::KNIGHT;
+		return true;
+	case 'B':
+		type = PieceType::BISHOP;
+		return true;
+	case 'R':
+		type = PieceType::ROOK;
+		return true;
+	case 'Q':
+		type = PieceType::QUEEN;
+		return true;
+	case 'K':
+		type = PieceType::KING;
+		return true;
+	default:
+		return false;
+	}
+}
+
+} // namespace
+
+Move parseSan(const Position& pos, std::string_view san) {
+	while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' ||
+					       san.back() == '?'))
+		san.remove_suffix(1);
+
+	MoveList moves;
+	generateLegalMoves(pos, moves);
+
+	// Some files write castling with zeros
+	if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+		uint8_t flag = san.size() == 3 ? Move::KING_CASTLE : Move::QUEEN_CASTLE;
+		for (Move m : moves) {
+			if (m.flags() == flag)
+				return m;
+		}
+		return Move::none();
+	}
+
+	PieceType type = PieceType::PAWN;
+	if (!san.empty() && pieceFromLetter(san.front(), type))
+		san.remove_prefix(1);
+
+	bool promotes = false;
+	PieceType promotion = PieceType::QUEEN;
+	if (san.size() >= 2 && pieceFromLetter(san.back(), promotion)) {
+		promotes = true;
+		san.remove_suffix(san[san.size() - 2] == '=' ? 2 : 1);
+	}
+
+	if (san.size() < 2 || !isFile(san[san.size() - 2]) || !isRank(san.back()))
+		return Move::none();
+	int to = ('8' - san.back()) * 8 + (san[san.size() - 2] - 'a');
+	san.remove_suffix(2);
+
+	// Whatever is left tells apart pieces of the same type reaching the same square
+	int from_file = -1;
+	int from_rank = -1;
+	for (char c : san) {
+		if (isFile(c))
+			from_file = c - 'a';
+		else if (isRank(c))
+			from_rank = '8' - c;
+		else if (c != 'x')
+			return Move::none();
+	}
+
+	Move found = Move::none();
+	for (Move m : moves) {
+		if (m.to() != to || typeOf(pos.pieceAt(m.from())) != type || m.isCastle())
+			continue;
+		if (m.isPromotion() != promotes || (promotes && m.promotion() != promotion))
+			continue;
+		if ((from_file >= 0 && m.from() % 8 != from_file) ||
+				(from_rank >= 0 && m.from() / 8 != from_rank))
+			continue;
+		if (found != Move::none())
+			return Move::none();
+		found = m;
+	}
+	return found;
+}
+
+std::string toSan(const Position& pos, Move m) {
+	std::string san;
+	if (m.flags() == Move::KING_CASTLE) {
+		san = "O-O";
+	} else if (m.flags() == Move::QUEEN_CASTLE) {
+		san = "O-O-O";
+	} else {
+		PieceCode piece = pos.pieceAt(m.from());
+		char from_file = static_cast<char>('a' + m.from() % 8);
+		char from_rank = static_cast<char>('8' - m.from() / 8);
+		if (typeOf(piece) == PieceType::PAWN) {
+			if (m.isCapture())
+				san += from_file;
+		} else {
+			san += pieceToChar(makePieceCode(Color::WHITE, typeOf(piece)));
+			// Only as much of the origin as it takes to tell the pieces apart, file first
+			MoveList moves;
+			generateLegalMoves(pos, moves);
+			bool ambiguous = false, shares_file = false, shares_rank = false;
+			for (Move other : moves) {
+				if (other == m || other.to() != m.to() || pos.pieceAt(other.from()) != piece)
+					continue;
+				ambiguous = true;
+				shares_file |= other.from() % 8 == m.from() % 8;
+				shares_rank |= other.from() / 8 == m.from() / 8;
+			}
+			if (ambiguous && (!shares_file || shares_rank))
+				san += from_file;
+			if (ambiguous && shares_file)
+				san += from_rank;
+		}
+		if (m.isCapture())
+			san += 'x';
+		san += squareToString(m.to());
+		if (m.isPromotion()) {
+			san += '=';
+			san += pieceToChar(makePieceCode(Color::WHITE, m.promotion()));
+		}
+	}
+
+	Position next = pos;
+	next.makeMove(m);
+	if (next.inCheck()) {
+		MoveList replies;
+		generateLegalMoves(next, replies);
+		san += replies.empty() ? '#' : '+';
+	}
+	return san;
+}
@@ -0,0 +1,305 @@
+#include "search.hpp"
+#include "evaluate.hpp"
+#include "movegen.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+namespace {
+
+// Ordering bands; each one outranks everything below it
+constexpr int first_move_score{1 << 30};
+constexpr int capture_score{1 << 24};
+constexpr int killer_score{1 << 22};
+constexpr int history_max{1 << 20};
+
+// Mate scores are stored relative to the node so they stay right when found again at another ply
+int scoreToTT(int score, int ply) {
+	if (score >= Search::mate_score - Search::max_ply)
+		return score + ply;
+	if (score <= -Search::mate_score + Search::max_ply)
+		return score - ply;
+	return score;
+}
+
+int scoreFromTT(int score, int ply) {
+	if (score >= Search::mate_score - Search::max_ply)
+		return score - ply;
+	if (score <= -Search::mate_score + Search::max_ply)
+		return score + ply;
+	return score;
+}
+
+constexpr int valueOf(PieceType t) {
+	return piece_values[static_cast<int>(t)];
+}
+
+// Moves the best-scored remaining move to position `i`; cheaper than sorting because most nodes
+// cut off after the first few moves
+void pickNext(MoveList& moves, std::array<int, MoveList::capacity>& scores, size_t i) {
+	size_t best = i;
+	for (size_t j = i + 1; j < moves.size(); j++) {
+		if (scores[j] > scores[best])
+			best = j;
+	}
+	std::swap(moves[i], moves[best]);
+	std::swap(scores[i], scores[best]);
+}
+
+} // namespace
+
+Search::Search(const std::atomic<bool>& stop_flag, TranspositionTable& table, int thread_id)
+	: stop(stop_flag)
+	, tt(table)
+	, id(thread_id) {
+}
+
+SearchResult Search::run(
+		const Position& root, const SearchLimits& limits, const std::vector<uint64_t>& game_keys) {
+	auto start = std::chrono::steady_clock::now();
+	has_deadline = limits.movetime_ms > 0;
+	deadline = start + std::chrono::milliseconds(limits.movetime_ms);
+	aborted = false;
+	pos = root;
+	keys = game_keys;
+	keys.push_back(pos.key());
+	nodes = 0;
+	killers = {};
+	history = {};
+
+	SearchResult result;
+	int max_depth = std::clamp(limits.depth, 1, max_ply - 1);
+	for (int depth = 1; depth <= max_depth; depth++) {
+		if (id > 0 && depth > 1 && (depth + id) % 2 == 0)
+			continue;
+		// The previous iteration's best move is searched first
+		root_first = result.best;
+		root_best = Move::none();
+		int score = alphaBeta(depth, 0, -infinity, infinity);
+		if (aborted)
+			break;
+		result.best = root_best;
+		result.score = score;
+		result.depth = depth;
+		result.nodes = nodes;
+		if (iteration_callback) {
+			result.time_ms = static_cast<uint64_t>(
+					std::chrono::duration_cast<std::chrono::milliseconds>(
+							std::chrono::steady_clock::now() - start)
+							.count());
+			extractPV(root, result.pv);
+			iteration_callback(result);
+		}
+
+		// A new iteration costs several times the previous one; do not start what cannot finish
+		if (has_deadline && std::chrono::steady_clock::now() - start >
+						std::chrono::milliseconds(limits.movetime_ms) / 2)
+			break;
+		if (std::abs(score) >= mate_score - max_ply)
+			break;
+	}
+
+	// Stopped before depth 1 completed: any legal move beats none
+	if (result.best == Move::none()) {
+		MoveList moves;
+		generateLegalMoves(root, moves);
+		if (!moves.empty())
+			result.best = moves[0];
+	}
+	result.nodes = nodes;
+	return result;
+}
+
+int Search::alphaBeta(int depth, int ply, int alpha, int beta) {
+	if (depth <= 0)
+		return quiescence(ply, alpha, beta);
+
+	nodes++;
+	if (shouldStop())
+		return 0;
+	if (ply > 0 && (pos.halfmoveClock() >= 100 || isRepetition()))
+		return 0;
+
+	Move tt_move = Move::none();
+	TTEntry entry;
+	if (tt.probe(pos.key(), entry)) {
+		tt_move = entry.move;
+		int score = scoreFromTT(entry.score, ply);
+		if (ply > 0 && entry.depth >= depth &&
+				(entry.bound == Bound::EXACT || (entry.bound == Bound::LOWER && score >= beta) ||
+						(entry.bound == Bound::UPPER && score <= alpha)))
+			return score;
+	}
+
+	bool in_check = pos.inCheck();
+	MoveList moves;
+	generateLegalMoves(pos, moves);
+	if (moves.empty())
+		return in_check ? -mate_score + ply : 0;
+	if (ply >= max_ply - 1)
+		return evaluate(pos);
+	if (in_check)
+		depth++;
+
+	MoveScores scores;
+	scoreMoves(moves, ply, ply == 0 && root_first != Move::none() ? root_first : tt_move, scores);
+
+	int original_alpha = alpha;
+	int best = -infinity;
+	Move best_move = Move::none();
+	Color us = pos.sideToMove();
+	for (size_t i = 0; i < moves.size(); i++) {
+		pickNext(moves, scores, i);
+		Move m = moves[i];
+		UndoInfo undo = pos.makeMove(m);
+		keys.push_back(pos.key());
+		int score = -alphaBeta(depth - 1, ply + 1, -beta, -alpha);
+		keys.pop_back();
+		pos.undoMove(m, undo);
+		if (aborted)
+			return 0;
+
+		if (score > best) {
+			best = score;
+			best_move = m;
+			if (ply == 0)
+				root_best = m;
+		}
+		alpha = std::max(alpha, score);
+		if (alpha >= beta) {
+			if (!m.isCapture() && !m.isPromotion()) {
+				if (killers[ply][0] != m) {
+					killers[ply][1] = killers[ply][0];
+					killers[ply][0] = m;
+				}
+				int& h = history[static_cast<int>(us)][m.from()][m.to()];
+				h = std::min(h + depth * depth, history_max - 1);
+			}
+			break;
+		}
+	}
+
+	// A fail low says nothing about which move is best
+	Bound bound = Bound::UPPER;
+	if (best >= beta)
+		bound = Bound::LOWER;
+	else if (best > original_alpha)
+		bound = Bound::EXACT;
+	else
+		best_move = Move::none();
+	tt.store(pos.key(), best_move, scoreToTT(best, ply), depth, bound);
+	return best;
+}
+
+int Search::quiescence(int ply, int alpha, int beta) {
+	nodes++;
+	if (shouldStop())
+		return 0;
+
+	int stand_pat = evaluate(pos);
+	if (ply >= max_ply - 1 || stand_pat >= beta)
+		return stand_pat;
+	alpha = std::max(alpha, stand_pat);
+
+	// Only captures and promotions, so the static evaluation is not taken in the middle of an
+	// exchange
+	MoveList moves;
+	generateLegalMoves(pos, moves);
+	size_t kept = 0;
+	for (Move m : moves) {
+		if (m.isCapture() || m.isPromotion())
+			moves[kept++] = m;
+	}
+	moves.resize(kept);
+
+	MoveScores scores;
+	scoreMoves(moves, ply, Move::none(), scores);
+
+	int best = stand_pat;
+	for (size_t i = 0; i < moves.size(); i++) {
+		pickNext(moves, scores, i);
+		Move m = moves[i];
+		UndoInfo undo = pos.makeMove(m);
+		int score = -quiescence(ply + 1, -beta, -alpha);
+		pos.undoMove(m, undo);
+		if (aborted)
+			return 0;
+
+		best = std::max(best, score);
+		alpha = std::max(alpha, score);
+		if (alpha >= beta)
+			break;
+	}
+	return best;
+}
+
+void Search::scoreMoves(const MoveList& moves, int ply, Move first, MoveScores& scores) const {
+	int us = static_cast<int>(pos.sideToMove());
+	for (size_t i = 0; i < moves.size(); i++) {
+		Move m = moves[i];
+		if (m == first) {
+			scores[i] = first_move_score;
+		} else if (m.isCapture() || m.isPromotion()) {
+			// Most valuable victim first, cheapest attacker breaking ties
+			int victim{0};
+			if (m.flags() == Move::EP_CAPTURE)
+				victim = valueOf(PieceType::PAWN);
+			else if (m.isCapture())
+				victim = valueOf(typeOf(pos.pieceAt(m.to())));
+			int attacker = valueOf(typeOf(pos.pieceAt(m.from())));
+			int promotion = m.isPromotion() ? valueOf(m.promotion()) : 0;
+			scores[i] = capture_score + (victim + promotion) * 16 - attacker / 16;
+		} else if (m == killers[ply][0]) {
+			scores[i] = killer_score + 1;
+		} else if (m == killers[ply][1]) {
+			scores[i] = killer_score;
+		} else {
+			scores[i] = history[us][m.from()][m.to()];
+		}
+	}
+}
+
+void Search::extractPV(const Position& root, MoveList& pv) const {
+	pv.clear();
+	if (root_best == Move::none())
+		return;
+	// The root move is known for sure, the rest is followed through the table
+	Position p = root;
+	std::vector<uint64_t> seen{p.key()};
+	pv.push_back(root_best);
+	p.makeMove(root_best);
+
+	TTEntry entry;
+	while (pv.size() < max_ply && tt.probe(p.key(), entry) && entry.move != Move::none()) {
+		// Another thread may have replaced the entry with one of a colliding position
+		MoveList legal;
+		generateLegalMoves(p, legal);
+		if (!legal.contains(entry.move) ||
+				std::find(seen.begin(), seen.end(), p.key()) != seen.end())
+			break;
+		seen.push_back(p.key());
+		pv.push_back(entry.move);
+		p.makeMove(entry.move);
+	}
+}
+
+bool Search::isRepetition() const {
+	// Only positions since the last capture or pawn move, with the same side to move
+	int last = static_cast<int>(keys.size()) - 1;
+	int oldest = std::max(0, last - pos.halfmoveClock());
+	for (int i = last - 2; i >= oldest; i -= 2) {
+		if (keys[i] == keys[last])
+			return true;
+	}
+	return false;
+}
+
+bool Search::shouldStop() {
+	// Reading the clock every node would cost more than the search
+	if (!aborted && (nodes & 1023) == 0) {
+		aborted = stop.load(std::memory_order_relaxed) ||
+			  (has_deadline && std::chrono::steady_clock::now() >= deadline);
+	}
+	return aborted;
+}
@@ -1,8 +1,19 @@
 #include "stockfish.hpp"
 #include <unistd.h>
-#include <fcntl.h>
-#include <sys/wait.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <cerrno>
+#include <cstdint>
 #include <cstring>
+#include <algorithm>
+
+namespace {
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
 
 Stockfish::Stockfish() {
 }
@@ -12,91 +23,211 @@ Stockfish::~Stockfish() {
 }
 
 bool Stockfish::start(const std::string& path) {
-    if (pipe(pipe_in) < 0 || pipe(pipe_out) < 0) return false;
-
-    pid = fork();
-    if (pid < 0) return false;
-
-    if (pid == 0) {
-        // Child process
-        dup2(pipe_in[0], STDIN_FILENO);
-        dup2(pipe_out[1], STDOUT_FILENO);
-        
-        close(pipe_in[0]); close(pipe_in[1]);
-        close(pipe_out[0]); close(pipe_out[1]);
-
-        execlp(path.c_str(), path.c_str(), nullptr);
-        std::exit(1);
-    } else {
-        close(pipe_in[0]);
-        close(pipe_out[1]);
-        
-        int flags = fcntl(pipe_out[0], F_GETFL, 0);
-        fcntl(pipe_out[0], F_SETFL, flags | O_NONBLOCK);
-        
-        writeCommand("uci");
-        return true;
+    if (process.pid > 0) return true;
+    auto spawn_start = std::chrono::steady_clock::now();
+    if (!spawnProcess(path, process, process_limits)) return false;
+    engine_timings = {};
+    engine_timings.spawn_ms = millisecondsSince(spawn_start);
+
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    reader_exited = false;
+    searches_started = 0;
+    searches_answered = 0;
+    reader = std::jthread([this] {
+        readLoop();
+        std::lock_guard lock(reply_mutex);
+        reader_exited = true;
+        reply_cv.notify_all();
+    });
+
+    // The handshake is done once per process; later games only send ucinewgame
+    auto handshake_start = std::chrono::steady_clock::now();
+    if (!sendAndWait("uci", uciok)) {
+        stop();
+        return false;
+    }
+    engine_timings.uciok_ms = millisecondsSince(handshake_start);
+    writeCommand("setoption name Ponder value true");
+    handshake_start = std::chrono::steady_clock::now();
+    if (!sendAndWait("isready", readyok)) {
+        stop();
+        return false;
     }
+    engine_timings.readyok_ms = millisecondsSince(handshake_start);
+    return true;
 }
 
 void Stockfish::stop() {
-    if (pid > 0) {
+    if (process.pid > 0) {
         writeCommand("quit");
-        waitpid(pid, nullptr, 0);
-        pid = -1;
+        uint64_t one = 1;
+        write(wake_fd, &one, sizeof(one));
+        if (reader.joinable()) reader.join();
+        close(wake_fd);
+        wake_fd = -1;
+        closeProcess(process);
     }
 }
 
+void Stockfish::setProcessLimits(const ProcessLimits& limits) {
+    process_limits = limits;
+    if (process.pid > 0) ::setProcessLimits(process.pid, limits);
+}
+
+void Stockfish::newGame() {
+    if (process.pid == -1) return;
+    auto start = std::chrono::steady_clock::now();
+    // A search left over from the last game would answer with a move for the wrong position
+    writeCommand("stop");
+    writeCommand("ucinewgame");
+    if (sendAndWait("isready", readyok)) engine_timings.newgame_ms = millisecondsSince(start);
+}
+
+bool Stockfish::sendAndWait(const std::string& cmd, bool& reply) {
+    {
+        std::lock_guard lock(reply_mutex);
+        reply = false;
+    }
+    writeCommand(cmd);
+    std::unique_lock lock(reply_mutex);
+    reply_cv.wait_for(lock, reply_timeout, [&] { return reply || reader_exited; });
+    return reply;
+}
+
 void Stockfish::setSkillLevel(int level) {
     if (level < 0) level = 0;
     if (level > 20) level = 20;
     writeCommand("setoption name Skill Level value " + std::to_string(level));
 }
 
+void Stockfish::setThreads(int threads) {
+    writeCommand("setoption name Threads value " + std::to_string(std::max(threads, 1)));
+}
+
+void Stockfish::setHashSize(int megabytes) {
+    writeCommand("setoption name Hash value " + std::to_string(std::max(megabytes, 1)));
+}
+
 void Stockfish::writeCommand(const std::string& cmd) {
-    if (pid == -1) return;
+    if (process.pid == -1) return;
     std::string full_cmd = cmd + "\n";
-    write(pipe_in[1], full_cmd.c_str(), full_cmd.length());
+    write(process.stdin_fd, full_cmd.c_str(), full_cmd.length());
 }
 
 void Stockfish::setPosition(const std::string& fen, const std::vector<std::string>& moves) {
-    accumulator.clear();
-    std::string cmd = "position fen " + fen;
-    if (!moves.empty()) {
-        cmd += " moves";
-        for (const auto& m : moves) cmd += " " + m;
+    // Drop answers to searches nobody waits for any more
+    BestMove stale;
+    while (best_moves.pop(stale)) {}
+    discardAnalysis();
+
+    // The command only grows during a game; it is rebuilt after a take back or a new game
+    std::optional<size_t> known = continueGame(fen, moves);
+    if (!known) {
+        known = 0;
+        position_cmd = fen == "startpos" ? "position startpos" : "position fen " + fen;
     }
-    writeCommand(cmd);
+    for (size_t i = *known; i < moves.size(); i++) {
+        if (i == 0) position_cmd += " moves";
+        position_cmd += ' ';
+        position_cmd += moves[i];
+    }
+    writeCommand(position_cmd);
 }
 
 void Stockfish::go(int depth, int movetime_ms) {
+    searches_started++;
     writeCommand("go depth " + std::to_string(depth) + " movetime " + std::to_string(movetime_ms));
 }
 
+void Stockfish::goPonder(int depth, int movetime_ms) {
+    searches_started++;
+    writeCommand("go ponder depth " + std::to_string(depth) + " movetime " + std::to_string(movetime_ms));
+}
+
+void Stockfish::ponderHit() {
+    writeCommand("ponderhit");
+}
+
+void Stockfish::setMultiPV(int lines) {
+    writeCommand("setoption name MultiPV value " + std::to_string(std::max(lines, 1)));
+}
+
+void Stockfish::goInfinite() {
+    searches_started++;
+    writeCommand("go infinite");
+}
+
+void Stockfish::stopSearch() {
+    writeCommand("stop");
+}
+
 std::optional<std::string> Stockfish::getBestMove() {
-    char buffer[4096];
-    ssize_t bytes = read(pipe_out[0], buffer, sizeof(buffer) - 1);
-    
-    if (bytes > 0) {
-        buffer[bytes] = '\0';
-        accumulator += buffer;
+    // Every go gets exactly one bestmove, so answers are matched to searches by count; a
+    // stopped ponder search still answers, after the search that replaced it was started
+    BestMove answer;
+    while (best_moves.pop(answer)) {
+        if (answer.search != searches_started) continue;
+        ponder_move = std::move(answer.ponder);
+        return std::move(answer.move);
     }
+    return std::nullopt;
+}
 
-    size_t pos = accumulator.find("bestmove");
-    if (pos != std::string::npos) {
-        size_t start = pos + 9;
-        size_t end = accumulator.find(' ', start);
-        if (end == std::string::npos) end = accumulator.find('\n', start);
-        
-        std::string moveStr = accumulator.substr(start, end - start);
-        
-        if (!moveStr.empty() && (moveStr.back() == '\r' || moveStr.back() == '\n')) {
-            moveStr.pop_back();
+std::string Stockfish::getPonderMove() const {
+    return ponder_move;
+}
+
+void Stockfish::readLoop() {
+    char buffer[4096];
+    std::string pending;
+    pollfd fds[2] = {{process.stdout_fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents & POLLIN) return;
+        if (!(fds[0].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+        ssize_t bytes = read(process.stdout_fd, buffer, sizeof(buffer));
+        if (bytes < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        // EOF: the engine exited or never started
+        if (bytes <= 0) return;
+
+        pending.append(buffer, static_cast<size_t>(bytes));
+        size_t start = 0;
+        for (size_t end; (end = pending.find('\n', start)) != std::string::npos; start = end + 1) {
+            std::string_view line(pending.data() + start, end - start);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            handleLine(line);
         }
-        
-        accumulator.clear();
-        return moveStr;
+        pending.erase(0, start);
     }
-    
-    return std::nullopt;
-}
\ No newline at end of file
+}
+
+void Stockfish::handleLine(std::string_view line) {
+    if (line.starts_with("info ")) {
+        AnalysisUpdate update;
+        if (parseInfoLine(line, update)) publishAnalysis(update);
+        return;
+    }
+    if (line == "uciok" || line == "readyok") {
+        std::lock_guard lock(reply_mutex);
+        (line == "uciok" ? uciok : readyok) = true;
+        reply_cv.notify_all();
+        return;
+    }
+    if (!line.starts_with("bestmove ")) return;
+
+    // bestmove <move> [ponder <move>]
+    BestMove answer;
+    answer.search = ++searches_answered;
+    std::string_view rest = line.substr(9);
+    answer.move = rest.substr(0, rest.find(' '));
+    if (size_t ponder = rest.find(" ponder "); ponder != std::string_view::npos) {
+        rest.remove_prefix(ponder + 8);
+        answer.ponder = rest.substr(0, rest.find(' '));
+    }
+    if (best_moves.push(std::move(answer))) notifyReady();
+}
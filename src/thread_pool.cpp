@@ -0,0 +1,92 @@
+#include "thread_pool.hpp"
+
+namespace {
+
+// Lets submit() tell a worker of this pool from any other thread
+thread_local const ThreadPool* current_pool{nullptr};
+thread_local size_t current_index{0};
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threads)
+	: queues(threads ? threads : 1) {
+	workers.reserve(queues.size());
+	for (size_t i = 0; i < queues.size(); i++)
+		workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(wake_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	// jthread joins on destruction
+	workers.clear();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	size_t index = current_pool == this ? current_index
+					     : next_queue.fetch_add(1, std::memory_order_relaxed) %
+							     queues.size();
+	pending.fetch_add(1);
+	{
+		std::lock_guard lock(queues[index].mutex);
+		queues[index].tasks.push_back(std::move(task));
+	}
+	{
+		// Counted under wake_mutex so a worker about to sleep cannot miss it
+		std::lock_guard lock(wake_mutex);
+		queued.fetch_add(1);
+	}
+	wake.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock lock(wake_mutex);
+	done.wait(lock, [this] { return pending.load() == 0; });
+}
+
+bool ThreadPool::popTask(size_t index, std::function<void()>& task) {
+	{
+		Queue& own = queues[index];
+		std::lock_guard lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+	for (size_t i = 1; i < queues.size(); i++) {
+		Queue& victim = queues[(index + i) % queues.size()];
+		std::lock_guard lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+	current_pool = this;
+	current_index = index;
+	while (true) {
+		std::function<void()> task;
+		if (popTask(index, task)) {
+			queued.fetch_sub(1);
+			task();
+			if (pending.fetch_sub(1) == 1) {
+				std::lock_guard lock(wake_mutex);
+				done.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock lock(wake_mutex);
+		wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+		if (stopping && queued.load() == 0)
+			return;
+	}
+}
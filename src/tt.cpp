@@ -0,0 +1,116 @@
+#include "tt.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+// Entry layout, low bits first: key 16, move 16, score 16, depth 8, bound 2, age 6
+constexpr uint64_t pack(uint16_t key, Move move, int score, int depth, Bound bound, uint8_t age) {
+	return uint64_t{key} | uint64_t{move.raw()} << 16 |
+	       uint64_t{static_cast<uint16_t>(static_cast<int16_t>(score))} << 32 |
+	       uint64_t{static_cast<uint8_t>(depth)} << 48 | uint64_t{static_cast<uint8_t>(bound)} << 56 |
+	       uint64_t{age} << 58;
+}
+
+constexpr uint16_t keyOf(uint64_t data) {
+	return static_cast<uint16_t>(data);
+}
+
+constexpr Move moveOf(uint64_t data) {
+	return Move(static_cast<int>(data >> 16) & 0x3F, static_cast<int>(data >> 22) & 0x3F,
+			static_cast<uint8_t>((data >> 28) & 0xF));
+}
+
+constexpr int depthOf(uint64_t data) {
+	return static_cast<uint8_t>(data >> 48);
+}
+
+constexpr Bound boundOf(uint64_t data) {
+	return static_cast<Bound>((data >> 56) & 3);
+}
+
+constexpr uint8_t ageOf(uint64_t data) {
+	return static_cast<uint8_t>(data >> 58);
+}
+
+// The bucket index comes from the low bits of the key, the check from the top 16
+constexpr uint16_t checkOf(uint64_t key) {
+	return static_cast<uint16_t>(key >> 48);
+}
+
+} // namespace
+
+TranspositionTable::TranspositionTable(size_t megabytes) {
+	resize(megabytes);
+}
+
+void TranspositionTable::resize(size_t megabytes) {
+	size_t count = std::bit_floor(std::max<size_t>(megabytes * 1024 * 1024 / sizeof(Bucket), 1));
+	if (count != bucket_count) {
+		buckets = std::make_unique<Bucket[]>(count);
+		bucket_count = count;
+	}
+	clear();
+}
+
+void TranspositionTable::clear() {
+	for (size_t i = 0; i < bucket_count; i++) {
+		for (auto& entry : buckets[i].entries)
+			entry.store(0, std::memory_order_relaxed);
+	}
+	age = 0;
+}
+
+TranspositionTable::Bucket& TranspositionTable::bucketFor(uint64_t key) const {
+	return buckets[key & (bucket_count - 1)];
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& entry) const {
+	for (const auto& slot : bucketFor(key).entries) {
+		uint64_t data = slot.load(std::memory_order_relaxed);
+		if (boundOf(data) != Bound::NONE && keyOf(data) == checkOf(key)) {
+			entry = {moveOf(data), static_cast<int16_t>(data >> 32), depthOf(data), boundOf(data)};
+			return true;
+		}
+	}
+	return false;
+}
+
+void TranspositionTable::store(uint64_t key, Move move, int score, int depth, Bound bound) {
+	Bucket& bucket = bucketFor(key);
+	uint16_t check = checkOf(key);
+
+	std::atomic<uint64_t>* target = &bucket.entries[0];
+	int worst = 0x7FFFFFFF;
+	for (auto& slot : bucket.entries) {
+		uint64_t data = slot.load(std::memory_order_relaxed);
+		if (boundOf(data) == Bound::NONE || keyOf(data) == check) {
+			// Keep the old move when re-storing a position without one, e.g. after a fail low
+			if (move == Move::none() && keyOf(data) == check)
+				move = moveOf(data);
+			target = &slot;
+			break;
+		}
+		// Each search of age costs an entry as much as eight plies of depth
+		int age_diff = (age - ageOf(data)) & age_mask;
+		int value = depthOf(data) - 8 * age_diff;
+		if (value < worst) {
+			worst = value;
+			target = &slot;
+		}
+	}
+	target->store(pack(check, move, score, depth, bound, age), std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+	int used{0};
+	size_t sample = std::min<size_t>(bucket_count, 1000 / bucket_size);
+	for (size_t i = 0; i < sample; i++) {
+		for (const auto& slot : buckets[i].entries) {
+			uint64_t data = slot.load(std::memory_order_relaxed);
+			used += boundOf(data) != Bound::NONE && ageOf(data) == age;
+		}
+	}
+	return static_cast<int>(used * 1000 / (sample * bucket_size));
+}
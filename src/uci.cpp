@@ -0,0 +1,89 @@
+#include "uci.hpp"
+
+#include <charconv>
+
+namespace {
+
+// Splits on spaces and tabs without copying
+class Tokenizer {
+public:
+	explicit Tokenizer(std::string_view text)
+		: rest(text) {
+	}
+
+	std::string_view next() {
+		size_t start = rest.find_first_not_of(" \t");
+		if (start == std::string_view::npos) {
+			rest = {};
+			return {};
+		}
+		rest.remove_prefix(start);
+		size_t end = rest.find_first_of(" \t");
+		std::string_view token = rest.substr(0, end);
+		rest.remove_prefix(end == std::string_view::npos ? rest.size() : end);
+		return token;
+	}
+
+private:
+	std::string_view rest;
+};
+
+template <typename T>
+bool parseNumber(std::string_view token, T& value) {
+	auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+	return ec == std::errc{} && ptr == token.data() + token.size();
+}
+
+} // namespace
+
+bool parseInfoLine(std::string_view line, AnalysisUpdate& update) {
+	Tokenizer tokens(line);
+	if (tokens.next() != "info")
+		return false;
+
+	update = {};
+	bool has_score{false};
+	for (std::string_view token = tokens.next(); !token.empty(); token = tokens.next()) {
+		bool ok{true};
+		if (token == "depth") {
+			ok = parseNumber(tokens.next(), update.depth);
+		} else if (token == "seldepth") {
+			ok = parseNumber(tokens.next(), update.seldepth);
+		} else if (token == "multipv") {
+			ok = parseNumber(tokens.next(), update.multipv);
+		} else if (token == "nodes") {
+			ok = parseNumber(tokens.next(), update.nodes);
+		} else if (token == "nps") {
+			ok = parseNumber(tokens.next(), update.nps);
+		} else if (token == "time") {
+			ok = parseNumber(tokens.next(), update.time_ms);
+		} else if (token == "hashfull") {
+			ok = parseNumber(tokens.next(), update.hashfull);
+		} else if (token == "score") {
+			std::string_view kind = tokens.next();
+			update.mate = kind == "mate";
+			ok = (kind == "cp" || kind == "mate") && parseNumber(tokens.next(), update.score);
+			has_score = ok;
+		} else if (token == "lowerbound") {
+			update.lowerbound = true;
+		} else if (token == "upperbound") {
+			update.upperbound = true;
+		} else if (token == "pv") {
+			// The PV runs to the end of the line
+			for (std::string_view move = tokens.next(); !move.empty(); move = tokens.next()) {
+				if (update.pv_length == AnalysisUpdate::max_pv || move.size() > 5)
+					break;
+				UciMove& m = update.pv[update.pv_length++];
+				m.length = static_cast<uint8_t>(move.copy(m.text.data(), m.text.size()));
+			}
+		} else if (token == "string") {
+			break;
+		} else if (token == "currmove" || token == "currmovenumber" || token == "tbhits" ||
+				token == "cpuload" || token == "sbhits") {
+			tokens.next();
+		}
+		if (!ok)
+			return false;
+	}
+	return has_score;
+}
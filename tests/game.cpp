@@ -0,0 +1,121 @@
+// The rules Game decides on its own: repetition, the fifty-move rule, mate, stalemate, the clock,
+// and taking moves back. Exits with a failure if any case does not hold.
+#include "game.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <print>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+int failures{0};
+
+void check(bool ok, std::string_view what) {
+	if (!ok) {
+		std::println("FAILED: {}", what);
+		failures++;
+	}
+}
+
+// Plays the UCI moves in `line`; false as soon as one is refused
+bool playLine(Game& game, std::string_view line, int64_t spent_ms = 0) {
+	std::istringstream moves{std::string(line)};
+	std::string uci;
+	while (moves >> uci) {
+		if (!game.play(uci, spent_ms))
+			return false;
+	}
+	return true;
+}
+
+void checkRepetition() {
+	Game game;
+	// The start position comes back after 4 and after 8 plies
+	check(playLine(game, "g1f3 g8f6 f3g1 f6g8 g1f3 g8f6 f3g1"), "knight moves refused");
+	check(!game.isOver(), "over before the third repetition");
+	check(game.play("f6g8"), "last knight move refused");
+	check(game.endReason() == GameEnd::REPETITION && game.outcome() == GameResult::DRAW,
+			"threefold repetition not a draw");
+	check(!game.play("e2e4"), "move accepted after the game ended");
+
+	// The first occurrence follows a double push no pawn can take en passant
+	game.reset();
+	check(playLine(game, "e2e4 g8f6 g1f3 f6g8 f3g1 g8f6 g1f3 f6g8 f3g1"), "moves after e4 refused");
+	check(game.endReason() == GameEnd::REPETITION, "repetition after a double push missed");
+}
+
+void checkFiftyMoves() {
+	Game game("4k3/8/8/8/8/8/8/R3K3 w - - 98 80");
+	check(game.play("a1a2"), "rook move refused");
+	check(!game.isOver(), "over after 99 half-moves");
+	check(game.play("e8d8"), "king move refused");
+	check(game.endReason() == GameEnd::FIFTY_MOVES && game.outcome() == GameResult::DRAW,
+			"fifty-move rule not a draw");
+
+	// A pawn move starts the count again
+	game.reset("4k3/8/8/8/8/8/4P3/4K3 w - - 99 80");
+	check(game.play("e2e3") && !game.isOver(), "pawn move did not reset the count");
+}
+
+void checkMateAndStalemate() {
+	Game game;
+	check(playLine(game, "f2f3 e7e5 g2g4 d8h4"), "fool's mate refused");
+	check(game.endReason() == GameEnd::CHECKMATE && game.outcome() == GameResult::BLACK_WINS,
+			"fool's mate not a win for black");
+	check(game.status() == "Checkmate!", "status after mate");
+	check(game.legalMoves().size() == 0, "legal moves after mate");
+
+	game.reset("7k/8/5QK1/8/8/8/8/8 w - - 0 1");
+	check(game.play("f6f7"), "queen move refused");
+	check(game.endReason() == GameEnd::STALEMATE && game.outcome() == GameResult::DRAW,
+			"stalemate not a draw");
+}
+
+void checkClocks() {
+	Game game("startpos", {1000, 0});
+	check(game.play("e2e4", 400) && game.timeLeft(Color::WHITE) == 600, "white clock");
+	check(game.play("e7e5", 100) && game.timeLeft(Color::BLACK) == 900, "black clock");
+	// The flag falls: the move is not played and white loses
+	check(!game.play("g1f3", 600), "move accepted after the flag fell");
+	check(game.endReason() == GameEnd::TIME && game.outcome() == GameResult::BLACK_WINS,
+			"running out of time not a loss");
+	check(game.timeLeft(Color::WHITE) == 0 && game.ply() == 2, "state after the flag fell");
+
+	// Increments are added after the move, and taking moves back restores both clocks
+	game.reset("startpos", {60000, 2000});
+	check(game.play("e2e4", 5000) && game.timeLeft(Color::WHITE) == 57000, "increment");
+	check(game.play("e7e5", 3000) && game.timeLeft(Color::BLACK) == 59000, "black increment");
+	check(game.takeBack() && game.timeLeft(Color::BLACK) == 60000 &&
+			      game.sideToMove() == Color::BLACK && game.ply() == 1,
+			"take back of black's move");
+	check(game.takeBack() && game.timeLeft(Color::WHITE) == 60000 && game.ply() == 0,
+			"take back of white's move");
+	check(!game.takeBack(), "take back at the start of the game");
+
+	// A mate taken back is a game again
+	game.reset();
+	playLine(game, "f2f3 e7e5 g2g4 d8h4");
+	check(game.takeBack() && !game.isOver() && game.moves().size() == 3, "mate taken back");
+}
+
+void checkIllegal() {
+	Game game;
+	check(!game.play("e2e5") && game.ply() == 0 && !game.isOver(), "illegal move accepted");
+	check(!game.reset("not a fen") && game.startFen() == "startpos", "invalid FEN accepted");
+}
+
+} // namespace
+
+int32_t main() {
+	checkRepetition();
+	checkFiftyMoves();
+	checkMateAndStalemate();
+	checkClocks();
+	checkIllegal();
+	if (failures)
+		std::println("{} checks FAILED", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
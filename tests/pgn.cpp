@@ -0,0 +1,167 @@
+// SAN in both directions and PGN archives written by writePgn read back by PgnReader, move for
+// move. Exits with a failure if any case does not hold.
+#include "game.hpp"
+#include "pgn.hpp"
+#include "san.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iterator>
+#include <print>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+int failures{0};
+
+void check(bool ok, std::string_view what) {
+	if (!ok) {
+		std::println("FAILED: {}", what);
+		failures++;
+	}
+}
+
+struct SanCase {
+	const char* fen;
+	const char* uci;
+	const char* san;
+};
+
+constexpr SanCase san_cases[] = {
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "g1f3", "Nf3"},
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "e2e4", "e4"},
+	{"r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "e1g1", "O-O"},
+	{"r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "e1c1", "O-O-O"},
+	{"r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1", "e8g8", "O-O"},
+	{"8/P7/8/8/8/8/8/k6K w - - 0 1", "a7a8q", "a8=Q+"},
+	{"8/P7/8/8/8/8/8/k6K w - - 0 1", "a7a8n", "a8=N"},
+	{"1r6/P7/8/8/8/8/8/k6K w - - 0 1", "a7b8q", "axb8=Q"},
+	{"4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 2", "e5d6", "exd6"},
+	// Disambiguation by file, by rank and by both
+	{"4k3/8/8/8/8/8/8/1N2KN2 w - - 0 1", "b1d2", "Nbd2"},
+	{"4k3/8/8/R7/8/8/8/R3K3 w - - 0 1", "a1a3", "R1a3"},
+	{"4k3/8/8/8/8/Q7/8/Q1Q1K3 w - - 0 1", "a1b2", "Qa1b2"},
+	{"4k3/8/8/8/8/8/8/R3K3 w - - 0 1", "a1a8", "Ra8+"},
+	{"rnbqkbnr/pppp1ppp/8/4p3/6P1/5P2/PPPPP2P/RNBQKBNR b KQkq g3 0 2", "d8h4", "Qh4#"},
+};
+
+// Tokens that read as a move, or as none at all, in the given position
+struct ParseCase {
+	const char* fen;
+	const char* san;
+	const char* uci;
+};
+
+constexpr ParseCase parse_cases[] = {
+	{"r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "0-0", "e1g1"},
+	{"r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "0-0-0", "e1c1"},
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "Nf3!?", "g1f3"},
+	{"8/P7/8/8/8/8/8/k6K w - - 0 1", "a8Q", "a7a8q"},
+	// Both knights reach d2, so the token is ambiguous
+	{"4k3/8/8/8/8/8/8/1N2KN2 w - - 0 1", "Nd2", ""},
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "e5", ""},
+	{"4k3/8/8/8/8/8/8/4K3 w - - 0 1", "O-O", ""},
+	// Rights given for a rook or king that is not at home are dropped
+	{"4k3/8/8/8/8/8/8/R3K3 w KQ - 0 1", "O-O", ""},
+	{"r3k3/8/8/8/8/8/8/4K3 b kq - 0 1", "O-O-O", "e8c8"},
+};
+
+void checkSan() {
+	for (const SanCase& c : san_cases) {
+		Position pos;
+		pos.setFEN(c.fen);
+		Move m = pos.parseMove(c.uci);
+		std::string san = toSan(pos, m);
+		check(san == c.san, std::format("{} in {} written {}, expected {}", c.uci, c.fen, san,
+					    c.san));
+		check(parseSan(pos, c.san) == m, std::format("{} in {} not read back", c.san, c.fen));
+	}
+	for (const ParseCase& c : parse_cases) {
+		Position pos;
+		pos.setFEN(c.fen);
+		Move m = parseSan(pos, c.san);
+		std::string uci = m == Move::none() ? "" : m.toUci();
+		check(uci == c.uci, std::format("{} in {} read as '{}', expected '{}'", c.san, c.fen, uci,
+					    c.uci));
+	}
+}
+
+// Castling written with zeros, as some exporters do, both glued to the move number and not
+void checkZeroCastling() {
+	constexpr std::string_view text{
+		"[Event \"castling\"]\n\n1. e4 e5 2. Nf3 Nc6 3. Bc4 Bc5 4.0-0 d6 5. d3 Bg4 6. Nc3 Qd7\n"
+		"7. Be3 Nf6 8. Qe2 0-0-0 1/2-1/2\n"};
+	PgnReader reader(text);
+	PgnGame game;
+	bool read = reader.next(game);
+	check(read && !game.broken && game.moves.size() == 16 && game.moves[6].isCastle() &&
+			      game.moves[15].isCastle(),
+			"castling written as 0-0 or 0-0-0");
+	check(read && game.result == GameResult::DRAW, "result after 0-0-0");
+}
+
+// Random games, some from a FEN and some with comments, written to one archive and read back
+void checkRoundTrip() {
+	constexpr const char* starts[] = {
+		"startpos",
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		"8/2P5/8/8/8/8/5p2/K1k5 b - - 0 40",
+	};
+	std::mt19937_64 rng{7};
+	std::string archive;
+	std::vector<Game> games;
+	for (int i = 0; i < 60; i++) {
+		Game game(starts[i % std::size(starts)]);
+		std::vector<std::string> comments;
+		while (!game.isOver() && game.ply() < 120) {
+			const MoveList& moves = game.legalMoves();
+			game.play(moves[rng() % moves.size()]);
+			comments.push_back(i % 2 ? "" : "ply " + std::to_string(game.ply()) + " {nested}");
+		}
+		if (!game.isOver())
+			game.adjudicate(GameResult::DRAW);
+		PgnHeaders headers;
+		headers.round = std::to_string(i + 1);
+		headers.white = "Some \"quoted\" name";
+		writePgn(archive, game, headers, comments);
+		games.push_back(std::move(game));
+	}
+
+	PgnReader reader(archive);
+	PgnGame read;
+	size_t count{0};
+	while (reader.next(read)) {
+		if (count >= games.size())
+			break;
+		const Game& game = games[count];
+		std::string name = std::format("game {}", count + 1);
+		check(!read.broken, name + " read as broken");
+		check(read.result == game.outcome(), name + " result");
+		check(read.tag("White") == "Some \\\"quoted\\\" name", name + " escaped tag");
+		bool same = read.moves.size() == game.moves().size();
+		for (size_t j = 0; same && j < read.moves.size(); j++)
+			same = read.moves[j].toUci() == game.moves()[j];
+		check(same, name + " moves");
+		if (game.startFen() != "startpos")
+			check(read.tag("FEN") == game.startFen(), name + " FEN tag");
+		count++;
+	}
+	check(count == games.size(), std::format("{} of {} games read", count, games.size()));
+}
+
+} // namespace
+
+int32_t main() {
+	Bitboards::init();
+	checkSan();
+	checkZeroCastling();
+	checkRoundTrip();
+	if (failures)
+		std::println("{} checks FAILED", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+// Polyglot books: the keys of the specification's test positions, and moves decoded from a small
+// book written here, castling and promotions included. Exits with a failure if any case does not
+// hold.
+#include "polyglot.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <print>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+int failures{0};
+
+void check(bool ok, std::string_view what) {
+	if (!ok) {
+		std::println("FAILED: {}", what);
+		failures++;
+	}
+}
+
+Position afterMoves(std::string_view moves, const char* fen = Position::start_fen) {
+	Position pos;
+	pos.setFEN(fen);
+	while (!moves.empty()) {
+		std::string_view uci = moves.substr(0, moves.find(' '));
+		moves.remove_prefix(std::min(moves.size(), uci.size() + 1));
+		pos.makeMove(pos.parseMove(uci));
+	}
+	return pos;
+}
+
+// The test positions of the specification
+void checkKeys(const PolyglotBook& book) {
+	struct KeyTest {
+		const char* moves;
+		uint64_t key;
+	};
+	constexpr KeyTest tests[] = {
+		{"", 0x463b96181691fc9c},
+		{"e2e4", 0x823c9b50fd114196},
+		{"e2e4 d7d5", 0x0756b94461c50fb0},
+		{"e2e4 d7d5 e4e5", 0x662fafb965db29d4},
+		{"e2e4 d7d5 e4e5 f7f5", 0x22a48b5a8e47ff78},
+		{"e2e4 d7d5 e4e5 f7f5 e1e2", 0x652a607ca3f242c1},
+		{"e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00fdd303c946bdd9},
+		{"a2a4 b7b5 h2h4 b5b4 c2c4", 0x3c8123ea7b067637},
+		{"a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5c3f9b829b279560},
+	};
+	for (const KeyTest& test : tests) {
+		uint64_t key = book.key(afterMoves(test.moves));
+		check(key == test.key, std::format("key after '{}' is {:016x}", test.moves, key));
+	}
+}
+
+// Squares as Polyglot numbers them, a1 = 0
+uint16_t encode(std::string_view from, std::string_view to, int promotion = 0) {
+	auto square = [](std::string_view sq) { return (sq[1] - '1') * 8 + (sq[0] - 'a'); };
+	return static_cast<uint16_t>(promotion << 12 | square(from) << 6 | square(to));
+}
+
+struct BookEntry {
+	uint64_t key;
+	uint16_t move;
+	uint16_t weight;
+};
+
+bool writeBook(const std::string& path, std::vector<BookEntry> entries) {
+	std::sort(entries.begin(), entries.end(),
+			[](const BookEntry& a, const BookEntry& b) { return a.key < b.key; });
+	std::vector<unsigned char> bytes;
+	auto put = [&](uint64_t value, int count) {
+		for (int i = count - 1; i >= 0; i--)
+			bytes.push_back(static_cast<unsigned char>(value >> (8 * i)));
+	};
+	for (const BookEntry& e : entries) {
+		put(e.key, 8);
+		put(e.move, 2);
+		put(e.weight, 2);
+		put(0, 4);
+	}
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	return std::fclose(file) == 0 && ok;
+}
+
+void checkBook(PolyglotBook& book, const std::filesystem::path& dir) {
+	constexpr const char* castling{"r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1"};
+	constexpr const char* promotion{"8/P7/8/8/8/8/8/k6K w - - 0 1"};
+	Position start = afterMoves("");
+	Position castle = afterMoves("", castling);
+	Position black_castle = afterMoves("e1f1", castling);
+	Position promote = afterMoves("", promotion);
+
+	std::string path = (dir / "book.bin").string();
+	check(writeBook(path,
+			      {
+				      {book.key(start), encode("e2", "e4"), 3},
+				      {book.key(start), encode("d2", "d4"), 1},
+				      // Weight zero: never played
+				      {book.key(start), encode("g1", "f3"), 0},
+				      // Not legal here, so skipped
+				      {book.key(start), encode("e2", "e5"), 50},
+				      // Castling is written as the king taking its own rook
+				      {book.key(castle), encode("e1", "h1"), 1},
+				      {book.key(black_castle), encode("e8", "a8"), 1},
+				      // Promotion to a knight is 1
+				      {book.key(promote), encode("a7", "a8", 1), 1},
+			      }),
+			"writing the book");
+	check(book.open(path) && book.isOpen() && book.size() == 7, "opening the book");
+
+	std::mt19937_64 rng{1};
+	int e4{0};
+	int d4{0};
+	for (int i = 0; i < 4000; i++) {
+		std::string move = book.pick(start, rng).toUci();
+		e4 += move == "e2e4";
+		d4 += move == "d2d4";
+	}
+	check(e4 + d4 == 4000, "moves with no weight or not legal picked");
+	check(e4 > 2 * d4 && e4 < 4 * d4, std::format("weights 3 to 1 picked {} to {}", e4, d4));
+
+	Move m = book.pick(castle, rng);
+	check(m.isCastle() && m.flags() == Move::KING_CASTLE, "white castling short");
+	m = book.pick(black_castle, rng);
+	check(m.isCastle() && m.flags() == Move::QUEEN_CASTLE, "black castling long");
+	check(book.pick(promote, rng).toUci() == "a7a8n", "promotion to a knight");
+
+	// Positions the book does not hold, or too late in the game
+	check(book.pick(afterMoves("e2e4"), rng) == Move::none(), "move for an unknown position");
+	book.setMaxMoves(0);
+	check(book.pick(start, rng) == Move::none(), "move past the book's depth");
+
+	// Not a whole number of entries
+	std::filesystem::resize_file(path, 7 * 16 - 1);
+	check(!book.open(path) && !book.isOpen(), "truncated book opened");
+}
+
+} // namespace
+
+int32_t main() {
+	Bitboards::init();
+	std::filesystem::path dir = std::filesystem::temp_directory_path() /
+				    ("polyglot-test-" + std::to_string(getpid()));
+	std::filesystem::create_directories(dir);
+	PolyglotBook book;
+	checkKeys(book);
+	checkBook(book, dir);
+	std::filesystem::remove_all(dir);
+	if (failures)
+		std::println("{} checks FAILED", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+// ResultCache: least recently used eviction, limits and variants kept apart, answers saved and
+// mapped back, and files that must not be mapped. Exits with a failure if any case does not hold.
+#include "result_cache.hpp"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <print>
+#include <string>
+#include <string_view>
+
+namespace {
+
+int failures{0};
+
+void check(bool ok, std::string_view what) {
+	if (!ok) {
+		std::println("FAILED: {}", what);
+		failures++;
+	}
+}
+
+constexpr SearchLimits limits{10, 1000};
+
+CachedResult answer(std::string_view move, int score) {
+	CachedResult result;
+	result.best_move.length = static_cast<uint8_t>(move.copy(result.best_move.text.data(), 5));
+	result.score = score;
+	result.depth = 10;
+	return result;
+}
+
+bool holds(ResultCache& cache, uint64_t position, std::string_view move,
+		const SearchLimits& search = limits, uint32_t variant = 0) {
+	CachedResult result;
+	return cache.lookup(position, search, variant, result) && result.best_move.view() == move;
+}
+
+void checkEviction() {
+	ResultCache cache(3);
+	cache.store(1, limits, 0, answer("e2e4", 10));
+	cache.store(2, limits, 0, answer("d2d4", 20));
+	cache.store(3, limits, 0, answer("c2c4", 30));
+	// Looking 1 up makes 2 the least recently used
+	check(holds(cache, 1, "e2e4"), "first answer");
+	cache.store(4, limits, 0, answer("g1f3", 40));
+	check(cache.size() == 3, "capacity exceeded");
+	check(!holds(cache, 2, "d2d4"), "least recently used answer kept");
+	check(holds(cache, 1, "e2e4") && holds(cache, 3, "c2c4") && holds(cache, 4, "g1f3"),
+			"recent answers evicted");
+
+	// Storing again replaces the answer without growing
+	cache.store(4, limits, 0, answer("b1c3", 41));
+	check(cache.size() == 3 && holds(cache, 4, "b1c3"), "answer not replaced");
+
+	// Other limits and other variants are other answers
+	check(!holds(cache, 1, "e2e4", {12, 1000}), "answer for other limits");
+	check(!holds(cache, 1, "e2e4", limits, 1), "answer for another variant");
+	check(cache.hits() > 0 && cache.misses() == 3, "hit and miss counts");
+}
+
+void checkSaveAndOpen(const std::filesystem::path& dir) {
+	std::string path = (dir / "cache.bin").string();
+	{
+		ResultCache cache(8);
+		for (uint64_t i = 0; i < 6; i++)
+			cache.store(i * 0x9E3779B97F4A7C15ull, limits, 0, answer("e2e4", static_cast<int>(i)));
+		cache.store(7, limits, 2, answer("a7a8q", -3));
+		check(cache.save(path), "save");
+	}
+
+	ResultCache cache(8);
+	check(cache.open(path), "open after save");
+	check(cache.size() == 0, "mapped answers counted as in memory");
+	CachedResult result;
+	check(cache.lookup(5 * 0x9E3779B97F4A7C15ull, limits, 0, result) && result.score == 5 &&
+			      result.depth == 10,
+			"answer from the file");
+	check(cache.size() == 1, "hit not promoted into memory");
+	check(holds(cache, 7, "a7a8q", limits, 2) && !holds(cache, 7, "a7a8q"), "variant on disk");
+
+	// Saving over the mapped file keeps what was not used from it
+	cache.store(100, limits, 0, answer("g1f3", 1));
+	check(cache.save(path), "save over the mapped file");
+	ResultCache reopened(16);
+	check(reopened.open(path), "open after saving over it");
+	check(holds(reopened, 100, "g1f3") && holds(reopened, 0, "e2e4") &&
+			      holds(reopened, 7, "a7a8q", limits, 2),
+			"answers lost by saving over the file");
+
+	// Closed, the file is no longer consulted
+	reopened.close();
+	check(!holds(reopened, 3 * 0x9E3779B97F4A7C15ull, "e2e4"), "answer after close");
+}
+
+bool writeFile(const std::string& path, const void* data, size_t size) {
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	bool ok = std::fwrite(data, 1, size, file) == size;
+	return std::fclose(file) == 0 && ok;
+}
+
+void checkBadFiles(const std::filesystem::path& dir) {
+	std::string path = (dir / "bad.bin").string();
+	ResultCache cache(4);
+	check(!cache.open((dir / "missing.bin").string()), "missing file opened");
+
+	// Magic, count, then one 32-byte record
+	unsigned char file[16 + 32]{};
+	std::memcpy(file, "CHESSRC1", 8);
+	uint64_t count{1};
+	std::memcpy(file + 8, &count, 8);
+	check(writeFile(path, file, sizeof(file)) && cache.open(path), "valid one-record file");
+
+	file[0] = 'X';
+	check(writeFile(path, file, sizeof(file)) && !cache.open(path), "bad magic opened");
+	file[0] = 'C';
+	check(writeFile(path, file, 16 + 31) && !cache.open(path), "truncated record opened");
+	check(writeFile(path, file, 10) && !cache.open(path), "truncated header opened");
+	count = 2;
+	std::memcpy(file + 8, &count, 8);
+	check(writeFile(path, file, sizeof(file)) && !cache.open(path), "count past the end opened");
+	// 2^59 + 1 records of 32 bytes wrap around to exactly one
+	count = (uint64_t{1} << 59) + 1;
+	std::memcpy(file + 8, &count, 8);
+	check(writeFile(path, file, sizeof(file)) && !cache.open(path), "overflowing count opened");
+}
+
+} // namespace
+
+int32_t main() {
+	std::filesystem::path dir = std::filesystem::temp_directory_path() /
+				    ("result-cache-test-" + std::to_string(getpid()));
+	std::filesystem::create_directories(dir);
+	checkEviction();
+	checkSaveAndOpen(dir);
+	checkBadFiles(dir);
+	std::filesystem::remove_all(dir);
+	if (failures)
+		std::println("{} checks FAILED", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+// The transposition table's replacement policy: a position keeps its own entry, a full bucket
+// gives up its shallowest entry, and older searches count for less. Exits with a failure if any
+// case does not hold.
+#include "tt.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <print>
+#include <string_view>
+
+namespace {
+
+int failures{0};
+
+void check(bool ok, std::string_view what) {
+	if (!ok) {
+		std::println("FAILED: {}", what);
+		failures++;
+	}
+}
+
+// Keys that share one bucket, which the low bits pick, and differ in the top 16 bits. Bucket 5
+// is among those hashfull() samples.
+constexpr uint64_t sameBucket(int i) {
+	return uint64_t(i + 1) << 48 | 5;
+}
+
+int depthOf(const TranspositionTable& tt, uint64_t key) {
+	TTEntry entry;
+	return tt.probe(key, entry) ? entry.depth : -1;
+}
+
+void checkRoundTrip() {
+	TranspositionTable tt(1);
+	TTEntry entry;
+	check(!tt.probe(sameBucket(0), entry), "hit in an empty table");
+
+	Move m(52, 36, Move::DOUBLE_PUSH);
+	tt.store(sameBucket(0), m, -1234, 17, Bound::LOWER);
+	check(tt.probe(sameBucket(0), entry), "stored entry missing");
+	check(entry.move == m && entry.score == -1234 && entry.depth == 17 &&
+			      entry.bound == Bound::LOWER,
+			"entry changed by storing it");
+	check(!tt.probe(sameBucket(1), entry), "hit for another position in the bucket");
+
+	// Stored again without a move, e.g. after a fail low, the position keeps its move
+	tt.store(sameBucket(0), Move::none(), 50, 18, Bound::UPPER);
+	check(tt.probe(sameBucket(0), entry) && entry.move == m && entry.depth == 18 &&
+			      entry.bound == Bound::UPPER,
+			"move lost when stored without one");
+
+	tt.clear();
+	check(!tt.probe(sameBucket(0), entry), "hit after clear");
+}
+
+void checkReplacement() {
+	TranspositionTable tt(1);
+	constexpr int depths[] = {10, 3, 7, 12};
+	for (int i = 0; i < 4; i++)
+		tt.store(sameBucket(i), Move::none(), 0, depths[i], Bound::EXACT);
+
+	// The same position overwrites its own entry, however shallow the new search
+	tt.store(sameBucket(0), Move::none(), 0, 2, Bound::EXACT);
+	check(depthOf(tt, sameBucket(0)) == 2, "position not overwritten in place");
+	for (int i = 1; i < 4; i++)
+		check(depthOf(tt, sameBucket(i)) == depths[i], "other entry lost on an overwrite");
+
+	// A fifth position takes the shallowest slot
+	tt.store(sameBucket(4), Move::none(), 0, 9, Bound::EXACT);
+	check(depthOf(tt, sameBucket(4)) == 9, "new position not stored");
+	check(depthOf(tt, sameBucket(0)) == -1, "shallowest entry kept");
+	check(depthOf(tt, sameBucket(1)) == 3 && depthOf(tt, sameBucket(2)) == 7 &&
+			      depthOf(tt, sameBucket(3)) == 12,
+			"deeper entry replaced");
+}
+
+void checkAging() {
+	TranspositionTable tt(1);
+	for (int i = 0; i < 4; i++)
+		tt.store(sameBucket(i), Move::none(), 0, 20, Bound::EXACT);
+	check(tt.hashfull() > 0, "hashfull of a used table");
+
+	// Three searches later, depth 20 is worth less than a fresh depth 1
+	for (int i = 0; i < 3; i++)
+		tt.newSearch();
+	check(tt.hashfull() == 0, "old entries counted by hashfull");
+	tt.store(sameBucket(4), Move::none(), 0, 1, Bound::EXACT);
+	tt.store(sameBucket(5), Move::none(), 0, 1, Bound::EXACT);
+	check(depthOf(tt, sameBucket(4)) == 1 && depthOf(tt, sameBucket(5)) == 1,
+			"fresh entry replaced before a stale one");
+	int stale{0};
+	for (int i = 0; i < 4; i++)
+		stale += depthOf(tt, sameBucket(i)) == 20;
+	check(stale == 2, std::format("{} of 4 stale entries left, expected 2", stale));
+
+	// One search later, depth still wins
+	tt.clear();
+	for (int i = 0; i < 4; i++)
+		tt.store(sameBucket(i), Move::none(), 0, 20, Bound::EXACT);
+	tt.newSearch();
+	tt.store(sameBucket(4), Move::none(), 0, 1, Bound::EXACT);
+	tt.store(sameBucket(5), Move::none(), 0, 1, Bound::EXACT);
+	check(depthOf(tt, sameBucket(4)) == -1 && depthOf(tt, sameBucket(5)) == 1,
+			"shallow fresh entry kept over deep ones of the last search");
+}
+
+} // namespace
+
+int32_t main() {
+	checkRoundTrip();
+	checkReplacement();
+	checkAging();
+	if (failures)
+		std::println("{} checks FAILED", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
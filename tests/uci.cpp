@@ -0,0 +1,105 @@
+// The UCI info line parser on what engines actually print: every field, bounds, mate scores,
+// long PVs and the lines that carry no score. Exits with a failure if any case does not hold.
+#include "uci.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <print>
+#include <string>
+#include <string_view>
+
+namespace {
+
+int failures{0};
+
+void check(bool ok, std::string_view what) {
+	if (!ok) {
+		std::println("FAILED: {}", what);
+		failures++;
+	}
+}
+
+std::string pvText(const AnalysisUpdate& update) {
+	std::string pv;
+	for (size_t i = 0; i < update.pv_length; i++) {
+		if (i)
+			pv += ' ';
+		pv += update.pv[i].view();
+	}
+	return pv;
+}
+
+void checkFields() {
+	AnalysisUpdate u;
+	check(parseInfoLine("info depth 24 seldepth 33 multipv 1 score cp 31 nodes 5263312 "
+			    "nps 1012561 hashfull 512 tbhits 0 time 5198 pv e2e4 e7e5 g1f3",
+			      u),
+			"full line refused");
+	check(u.depth == 24 && u.seldepth == 33 && u.multipv == 1, "depth, seldepth, multipv");
+	check(u.score == 31 && !u.mate && !u.lowerbound && !u.upperbound, "cp score");
+	check(u.nodes == 5263312 && u.nps == 1012561 && u.time_ms == 5198, "nodes, nps, time");
+	check(u.hashfull == 512, "hashfull");
+	check(pvText(u) == "e2e4 e7e5 g1f3", "pv");
+
+	check(parseInfoLine("info depth 18 multipv 2 score cp -12 upperbound nodes 1 pv d2d4", u),
+			"upperbound line refused");
+	check(u.multipv == 2 && u.score == -12 && u.upperbound && !u.lowerbound, "upper bound");
+	check(parseInfoLine("info depth 18 score cp 40 lowerbound", u) && u.lowerbound,
+			"lower bound");
+
+	check(parseInfoLine("info depth 31 score mate -6 pv h5f7 e8d8", u), "mate line refused");
+	check(u.mate && u.score == -6, "mated in 6");
+	check(parseInfoLine("info depth 9 score mate 1 pv a7a8q", u) && pvText(u) == "a7a8q",
+			"promotion in the pv");
+
+	// A previous update must not leak into the next one
+	check(parseInfoLine("info score cp 5", u), "bare score refused");
+	check(u.depth == 0 && u.pv_length == 0 && !u.mate && u.multipv == 1, "fields reset");
+}
+
+void checkTokens() {
+	AnalysisUpdate u;
+	check(parseInfoLine("info\tdepth  7\t score cp 3   pv\te2e4  ", u) && u.depth == 7 &&
+			      pvText(u) == "e2e4",
+			"tabs and repeated spaces");
+	// Fields this parser does not know are skipped, with their values
+	check(parseInfoLine("info depth 5 wdl 500 400 100 score cp 9 currmove e2e4 pv g1f3", u) &&
+			      u.score == 9 && pvText(u) == "g1f3",
+			"unknown fields");
+
+	// The PV is cut at max_pv moves
+	std::string line = "info depth 40 score cp 0 pv";
+	for (size_t i = 0; i < AnalysisUpdate::max_pv + 4; i++)
+		line += i % 2 ? " g8f6" : " g1f3";
+	check(parseInfoLine(line, u) && u.pv_length == AnalysisUpdate::max_pv, "long pv");
+}
+
+void checkRefused() {
+	AnalysisUpdate u;
+	constexpr const char* lines[] = {
+		"info depth 12 currmove g1f3 currmovenumber 3",
+		"info string NNUE evaluation using nn-b1a57edbea57.nnue enabled",
+		"info string score cp 100",
+		"bestmove e2e4 ponder e7e5",
+		"readyok",
+		"",
+		"info depth x score cp 5",
+		"info depth 5 score cp",
+		"info depth 5 score wdl 10",
+		"info depth 5 score cp 12abc",
+	};
+	for (const char* line : lines)
+		check(!parseInfoLine(line, u), std::format("'{}' accepted", line));
+}
+
+} // namespace
+
+int32_t main() {
+	checkFields();
+	checkTokens();
+	checkRefused();
+	if (failures)
+		std::println("{} checks FAILED", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
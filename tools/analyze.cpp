@@ -0,0 +1,267 @@
+// Analyses every position of the games in a PGN file, or every line of a FEN/EPD file, with a
+// pool of UCI engines and writes one evaluation per position. The positions/second it reports
+// is meant for comparing pool sizes on the same input; with --cache a rerun only searches
+// positions it has not seen.
+#include "engine_pool.hpp"
+#include "pgn.hpp"
+#include "position.hpp"
+#include "result_cache.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <future>
+#include <memory>
+#include <optional>
+#include <print>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A game as the engines get it: the start position and the moves played, in UCI notation
+struct GameMoves {
+	std::string fen{Position::start_fen};
+	Color first_to_move{Color::WHITE};
+	std::vector<std::string> moves;
+};
+
+void usage() {
+	std::println(stderr, "usage: analyze [--engine PATH] [--engines N] [--depth N] [--movetime MS]");
+	std::println(stderr, "               [--hash-mb N] [--nice N] [--pin] [--cache FILE]");
+	std::println(stderr, "               [--output FILE] FILE.pgn|FILE.fen");
+}
+
+bool parseNumber(std::string_view value, int& out, int min) {
+	auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), out);
+	return ec == std::errc{} && ptr == value.data() + value.size() && out >= min;
+}
+
+// Main lines of every game, read in parallel chunks. A game with a move that is not legal keeps
+// the moves before it.
+std::vector<GameMoves> readPgn(std::string_view text) {
+	size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::vector<GameMoves>> chunks(threads);
+	readPgnParallel(text, threads, [&](size_t chunk, const PgnGame& pgn) {
+		std::string_view fen = pgn.tag("FEN");
+		if (Position pos; !fen.empty() && !pos.setFEN(fen)) {
+			std::println(stderr, "skipping game with invalid FEN: {}", fen);
+			return;
+		}
+		if (pgn.broken) {
+			std::println(stderr, "game at byte {}: illegal move after {} moves", pgn.offset,
+					pgn.moves.size());
+		}
+		GameMoves game{pgn.start.fen(), pgn.start.sideToMove(), {}};
+		for (Move m : pgn.moves)
+			game.moves.push_back(m.toUci());
+		chunks[chunk].push_back(std::move(game));
+	});
+
+	std::vector<GameMoves> games;
+	for (std::vector<GameMoves>& chunk : chunks)
+		games.insert(games.end(), std::make_move_iterator(chunk.begin()),
+				std::make_move_iterator(chunk.end()));
+	return games;
+}
+
+// One position per line; EPD operations after the board fields are ignored by setFEN
+std::vector<GameMoves> readFens(std::string_view text) {
+	std::vector<GameMoves> games;
+	std::istringstream lines{std::string(text)};
+	Position pos;
+	for (std::string line; std::getline(lines, line);) {
+		if (line.empty() || line == "\r")
+			continue;
+		if (!pos.setFEN(line)) {
+			std::println(stderr, "skipping invalid FEN: {}", line);
+			continue;
+		}
+		games.push_back({pos.fen(), pos.sideToMove(), {}});
+	}
+	return games;
+}
+
+} // namespace
+
+int32_t main(int32_t argc, char* argv[]) {
+	// An engine that dies must not take the pool down with it on the next write
+	std::signal(SIGPIPE, SIG_IGN);
+	std::string engine{"stockfish"};
+	int engines = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	SearchLimits limits{12, 0};
+	int hash_mb{16};
+	std::optional<int> nice;
+	bool pin{false};
+	std::string output_path;
+	std::string cache_path;
+	std::string input_path;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg{argv[i]};
+		if (arg == "--engine" && i + 1 < argc) {
+			engine = argv[++i];
+		} else if (arg == "--engines" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], engines, 1)) {
+				std::println(stderr, "invalid engine count: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--depth" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], limits.depth, 1)) {
+				std::println(stderr, "invalid depth: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--movetime" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], limits.movetime_ms, 1)) {
+				std::println(stderr, "invalid movetime: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--hash-mb" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], hash_mb, 1)) {
+				std::println(stderr, "invalid hash size: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--nice" && i + 1 < argc) {
+			int level;
+			if (!parseNumber(argv[++i], level, 0) || level > 19) {
+				std::println(stderr, "invalid nice level: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+			nice = level;
+		} else if (arg == "--pin") {
+			pin = true;
+		} else if (arg == "--cache" && i + 1 < argc) {
+			cache_path = argv[++i];
+		} else if (arg == "--output" && i + 1 < argc) {
+			output_path = argv[++i];
+		} else if (!arg.starts_with("--") && input_path.empty()) {
+			input_path = arg;
+		} else {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (input_path.empty()) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	PgnFile input;
+	if (!input.open(input_path)) {
+		std::println(stderr, "cannot open {}", input_path);
+		return EXIT_FAILURE;
+	}
+	std::string_view text = input.text();
+	size_t first = text.find_first_not_of(" \t\r\n");
+	bool pgn = input_path.ends_with(".pgn") || (first != std::string::npos && text[first] == '[');
+
+	Bitboards::init();
+	std::vector<GameMoves> games = pgn ? readPgn(text) : readFens(text);
+
+	FILE* out = stdout;
+	if (!output_path.empty() && !(out = std::fopen(output_path.c_str(), "w"))) {
+		std::println(stderr, "cannot write {}", output_path);
+		return EXIT_FAILURE;
+	}
+
+	// Answers are only reused for the same engine binary and limits
+	std::unique_ptr<ResultCache> cache;
+	uint32_t cache_variant = static_cast<uint32_t>(std::hash<std::string>{}(engine));
+	if (!cache_path.empty()) {
+		size_t positions{0};
+		for (const GameMoves& game : games)
+			positions += game.moves.size() + 1;
+		cache = std::make_unique<ResultCache>(std::max<size_t>(positions, 1 << 16));
+		cache->open(cache_path);
+	}
+
+	// Every position of every game goes in the queue at once; results are written in order
+	auto start = std::chrono::steady_clock::now();
+	EnginePool pool(engine, static_cast<size_t>(engines), hash_mb, nice, pin);
+	std::vector<std::future<AnalysisResult>> results;
+	std::vector<uint64_t> keys;
+	size_t cached{0};
+	for (const GameMoves& game : games) {
+		Position pos;
+		pos.setFEN(game.fen);
+		for (size_t ply = 0; ply <= game.moves.size(); ply++) {
+			if (ply > 0)
+				pos.makeMove(pos.parseMove(game.moves[ply - 1]));
+			keys.push_back(pos.key());
+
+			CachedResult hit;
+			if (cache && cache->lookup(pos.key(), limits, cache_variant, hit)) {
+				AnalysisResult result;
+				result.best_move = hit.best_move.view();
+				result.info.score = hit.score;
+				result.info.mate = hit.mate;
+				result.info.depth = hit.depth;
+				std::promise<AnalysisResult> ready;
+				ready.set_value(result);
+				results.push_back(ready.get_future());
+				cached++;
+				continue;
+			}
+			std::vector<std::string> moves(game.moves.begin(), game.moves.begin() + ply);
+			results.push_back(pool.submit(AnalysisJob{game.fen, std::move(moves), limits}));
+		}
+	}
+
+	std::println(out, "game\tply\tmove\teval\tbest\tdepth");
+	size_t next = 0;
+	size_t failed = 0;
+	for (size_t g = 0; g < games.size(); g++) {
+		const GameMoves& game = games[g];
+		for (size_t ply = 0; ply <= game.moves.size(); ply++) {
+			uint64_t key = keys[next];
+			AnalysisResult result = results[next++].get();
+			if (result.best_move.empty()) {
+				failed++;
+				continue;
+			}
+			if (cache) {
+				CachedResult entry;
+				entry.best_move.length = static_cast<uint8_t>(result.best_move.copy(
+						entry.best_move.text.data(), entry.best_move.text.size()));
+				entry.score = result.info.score;
+				entry.mate = result.info.mate;
+				entry.depth = result.info.depth;
+				cache->store(key, limits, cache_variant, entry);
+			}
+			// Engines score from the side to move; the file is from white's side
+			bool white = (game.first_to_move == Color::WHITE) == (ply % 2 == 0);
+			int score = white ? result.info.score : -result.info.score;
+			std::string eval = result.info.mate ? std::format("#{}", score) :
+							      std::format("{:+.2f}", score / 100.0);
+			std::println(out, "{}\t{}\t{}\t{}\t{}\t{}", g + 1, ply,
+					ply ? game.moves[ply - 1] : "-", eval, result.best_move,
+					result.info.depth);
+		}
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (out != stdout)
+		std::fclose(out);
+
+	std::println(stderr, "{} positions in {:.2f} s, {:.1f} positions/second with {} engines",
+			results.size() - failed, elapsed, (results.size() - failed) / elapsed, engines);
+	if (cache) {
+		std::println(stderr, "{} answered from the cache", cached);
+		if (!cache->save(cache_path))
+			std::println(stderr, "cannot write {}", cache_path);
+	}
+	if (failed) {
+		std::println(stderr, "{} positions got no answer, is {} a UCI engine?", failed, engine);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,572 @@
+// Plays engine-vs-engine games, several at once, and reports the result of the first engine
+// against the second with an Elo estimate. Openings come from an EPD file, each played twice
+// with colours swapped. Finished games are appended to a PGN file as they end, and an SPRT
+// can stop the match as soon as it is decided. The headline number is games per hour, for
+// comparing settings and concurrency on the same machine.
+#include "bitboard.hpp"
+#include "builtin_engine.hpp"
+#include "game.hpp"
+#include "pgn.hpp"
+#include "stockfish.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// "builtin", "builtin:5" or the path of a UCI engine, optionally with ":skill" too
+struct EngineSpec {
+	std::string name;
+	std::string path;
+	bool builtin{false};
+	int skill{20};
+};
+
+struct Settings {
+	std::array<EngineSpec, 2> engines;
+	int games{100};
+	int concurrency{1};
+	SearchLimits limits{Search::max_ply, 100};
+	TimeControl time_control;
+	int hash_mb{16};
+	std::vector<std::string> openings{"startpos"};
+	std::string pgn_path;
+	bool sprt{false};
+	double elo0{0};
+	double elo1{5};
+	double alpha{0.05};
+	double beta{0.05};
+};
+
+void usage() {
+	std::println(stderr, "usage: match [--games N] [--concurrency N] [--depth N]");
+	std::println(stderr, "             [--movetime MS] [--tc SECONDS+INCREMENT] [--hash-mb N]");
+	std::println(stderr, "             [--openings FILE.epd] [--pgn FILE] [--sprt ELO0,ELO1]");
+	std::println(stderr, "             [--alpha A] [--beta B] ENGINE1 ENGINE2");
+	std::println(stderr, "ENGINE is builtin[:SKILL] or the path of a UCI engine[:SKILL]");
+}
+
+bool parseNumber(std::string_view value, int& out, int min) {
+	auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), out);
+	return ec == std::errc{} && ptr == value.data() + value.size() && out >= min;
+}
+
+bool parseNumber(std::string_view value, double& out) {
+	auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), out);
+	return ec == std::errc{} && ptr == value.data() + value.size();
+}
+
+bool parseEngine(std::string_view arg, EngineSpec& spec) {
+	spec = EngineSpec{};
+	if (size_t colon = arg.rfind(':'); colon != std::string_view::npos) {
+		if (!parseNumber(arg.substr(colon + 1), spec.skill, 0) || spec.skill > 20)
+			return false;
+		arg = arg.substr(0, colon);
+	}
+	if (arg.empty())
+		return false;
+	spec.builtin = arg == "builtin";
+	spec.path = arg;
+	spec.name = arg.substr(arg.rfind('/') + 1);
+	if (spec.skill < 20)
+		spec.name += std::format(" skill {}", spec.skill);
+	return true;
+}
+
+// "10+0.1": seconds of base time plus seconds of increment per move
+bool parseTimeControl(std::string_view arg, TimeControl& control) {
+	size_t plus = arg.find('+');
+	double base = 0, increment = 0;
+	if (!parseNumber(arg.substr(0, plus), base) || base <= 0)
+		return false;
+	if (plus != std::string_view::npos && (!parseNumber(arg.substr(plus + 1), increment) ||
+							      increment < 0))
+		return false;
+	control.base_ms = static_cast<int64_t>(base * 1000);
+	control.increment_ms = static_cast<int64_t>(increment * 1000);
+	return true;
+}
+
+// EPD is FEN without the move counters, followed by operations such as `bm` or `id`
+std::vector<std::string> readEpd(const std::string& path) {
+	std::vector<std::string> openings;
+	std::ifstream file(path);
+	Position pos;
+	for (std::string line; std::getline(file, line);) {
+		std::istringstream fields(line);
+		std::string board, side, castling, ep;
+		if (!(fields >> board >> side >> castling >> ep))
+			continue;
+		std::string fen = std::format("{} {} {} {} 0 1", board, side, castling, ep);
+		if (!pos.setFEN(fen)) {
+			std::println(stderr, "skipping invalid EPD line: {}", line);
+			continue;
+		}
+		openings.push_back(fen);
+	}
+	return openings;
+}
+
+// Lets a game thread sleep until one of its engines has news
+class Waker {
+public:
+	std::function<void()> callback() {
+		return [this] {
+			std::lock_guard lock(mutex);
+			woken = true;
+			cv.notify_one();
+		};
+	}
+
+	void arm() {
+		std::lock_guard lock(mutex);
+		woken = false;
+	}
+
+	// False once `deadline` passed without a wake-up
+	bool wait(std::chrono::steady_clock::time_point deadline) {
+		std::unique_lock lock(mutex);
+		return cv.wait_until(lock, deadline, [this] { return woken; });
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool woken{false};
+};
+
+std::unique_ptr<Engine> launch(const EngineSpec& spec, int hash_mb, Waker& waker) {
+	std::unique_ptr<Engine> engine;
+	if (spec.builtin) {
+		engine = std::make_unique<BuiltinEngine>();
+		engine->setNotify(waker.callback());
+		engine->start();
+	} else {
+		auto stockfish = std::make_unique<Stockfish>();
+		stockfish->setNotify(waker.callback());
+		if (!stockfish->start(spec.path))
+			return nullptr;
+		engine = std::move(stockfish);
+	}
+	engine->setSkillLevel(spec.skill);
+	engine->setThreads(1);
+	engine->setHashSize(hash_mb);
+	return engine;
+}
+
+int pieceCount(const Position& pos, Color side, PieceType type) {
+	return popCount(pos.pieces(side, type));
+}
+
+// Material the rules do not end a game on but tablebases settle: no pawns or majors and at most
+// one minor piece each, or two knights against a bare king, are draws. A bare king against a
+// queen or rook loses, unless it can take something right now.
+std::optional<GameResult> adjudicateMaterial(const Game& game) {
+	const Position& pos = game.position();
+	if (pos.pieces(PieceType::PAWN))
+		return std::nullopt;
+
+	std::array<int, 2> minors{}, majors{}, knights{};
+	for (Color side : {Color::WHITE, Color::BLACK}) {
+		int i = static_cast<int>(side);
+		knights[i] = pieceCount(pos, side, PieceType::KNIGHT);
+		minors[i] = knights[i] + pieceCount(pos, side, PieceType::BISHOP);
+		majors[i] = pieceCount(pos, side, PieceType::ROOK) +
+			    pieceCount(pos, side, PieceType::QUEEN);
+	}
+	if (majors[0] == 0 && majors[1] == 0) {
+		if (minors[0] <= 1 && minors[1] <= 1)
+			return GameResult::DRAW;
+		if ((knights[0] == 2 && minors[0] == 2 && minors[1] == 0) ||
+				(knights[1] == 2 && minors[1] == 2 && minors[0] == 0))
+			return GameResult::DRAW;
+		return std::nullopt;
+	}
+
+	for (Color strong : {Color::WHITE, Color::BLACK}) {
+		int s = static_cast<int>(strong);
+		int w = static_cast<int>(~strong);
+		if (majors[s] == 0 || majors[w] != 0 || minors[w] != 0)
+			continue;
+		if (pos.sideToMove() == ~strong) {
+			for (Move m : game.legalMoves()) {
+				if (m.isCapture())
+					return std::nullopt;
+			}
+		}
+		return strong == Color::WHITE ? GameResult::WHITE_WINS : GameResult::BLACK_WINS;
+	}
+	return std::nullopt;
+}
+
+struct PlayedGame {
+	int round{0};
+	// Index into Settings::engines of the engine playing white
+	int white{0};
+	Game game;
+	// Score, depth and time of every move
+	std::vector<std::string> comments;
+	std::string termination{"normal"};
+};
+
+// Plays one game; engines that stall or play an illegal move lose it
+PlayedGame playGame(const Settings& settings, int round, const std::string& opening,
+		std::array<std::unique_ptr<Engine>, 2>& engines, int white, Waker& waker) {
+	PlayedGame played;
+	played.round = round;
+	played.white = white;
+
+	Game& game = played.game;
+	game.reset(opening, settings.time_control);
+	for (auto& engine : engines)
+		engine->newGame();
+
+	while (!game.isOver()) {
+		Color side = game.sideToMove();
+		int index = side == Color::WHITE ? white : 1 - white;
+		Engine* engine = engines[index].get();
+
+		SearchLimits limits = settings.limits;
+		if (game.timed()) {
+			// A thirtieth of what is left plus most of the increment, never near the flag
+			int64_t left = game.timeLeft(side);
+			int64_t budget = left / 30 + game.timeControl().increment_ms * 3 / 4;
+			limits.movetime_ms = static_cast<int>(std::clamp<int64_t>(budget, 1, left / 2 + 1));
+		}
+
+		engine->setPosition(game.startFen(), game.moves());
+		auto start = std::chrono::steady_clock::now();
+		// Well past the limit before the engine is given up on
+		auto deadline = start + std::chrono::milliseconds(limits.movetime_ms * 2 + 5000);
+		engine->go(limits.depth, limits.movetime_ms);
+
+		AnalysisUpdate last{};
+		std::optional<std::string> answer;
+		while (true) {
+			waker.arm();
+			AnalysisUpdate update;
+			while (engine->getAnalysis(update)) {
+				if (update.multipv <= 1)
+					last = update;
+			}
+			if ((answer = engine->getBestMove()) || !waker.wait(deadline))
+				break;
+		}
+		auto spent = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - start);
+
+		GameResult loss = side == Color::WHITE ? GameResult::BLACK_WINS : GameResult::WHITE_WINS;
+		if (!answer) {
+			// A fresh process for the next game; the worker gives up if it does not start. The
+			// stalled one is killed if it ignores quit.
+			engines[index].reset();
+			engines[index] = launch(settings.engines[index], settings.hash_mb, waker);
+			game.adjudicate(loss);
+			played.termination = "stalled connection";
+			break;
+		}
+		Move m = game.position().parseMove(*answer);
+		if (!game.isLegal(m)) {
+			std::println(stderr, "{} played the illegal move {}",
+					settings.engines[index].name, *answer);
+			game.adjudicate(loss);
+			played.termination = "rules infraction";
+			break;
+		}
+
+		if (!game.play(m, spent.count())) {
+			played.termination = "time forfeit";
+			break;
+		}
+		std::string score = last.mate ? std::format("{}M{}", last.score < 0 ? "-" : "+",
+							       std::abs(last.score)) :
+						 std::format("{:+.2f}", last.score / 100.0);
+		played.comments.push_back(
+				std::format("{}/{} {:.3f}s", score, last.depth, spent.count() / 1000.0));
+
+		if (!game.isOver()) {
+			if (auto result = adjudicateMaterial(game)) {
+				game.adjudicate(*result);
+				played.termination = "adjudication";
+			}
+		}
+	}
+	return played;
+}
+
+std::string toPgn(const Settings& settings, const PlayedGame& played) {
+	std::time_t now = std::time(nullptr);
+	char date[16];
+	std::strftime(date, sizeof(date), "%Y.%m.%d", std::localtime(&now));
+
+	PgnHeaders headers;
+	headers.event = "match";
+	headers.date = date;
+	headers.round = std::to_string(played.round);
+	headers.white = settings.engines[played.white].name;
+	headers.black = settings.engines[1 - played.white].name;
+	if (settings.time_control.base_ms > 0) {
+		headers.extra.emplace_back("TimeControl",
+				std::format("{}+{}", settings.time_control.base_ms / 1000.0,
+						settings.time_control.increment_ms / 1000.0));
+	}
+	headers.extra.emplace_back("PlyCount", std::to_string(played.game.ply()));
+	headers.extra.emplace_back("Termination", played.termination);
+
+	std::string pgn;
+	writePgn(pgn, played.game, headers, played.comments);
+	return pgn;
+}
+
+// Win, draw and loss counts of the first engine
+struct Score {
+	int wins{0};
+	int draws{0};
+	int losses{0};
+
+	int games() const { return wins + draws + losses; }
+	double mean() const { return (wins + draws * 0.5) / games(); }
+	// Variance of one game's score
+	double variance() const {
+		double mu = mean();
+		return (wins * (1 - mu) * (1 - mu) + draws * (0.5 - mu) * (0.5 - mu) + losses * mu * mu) /
+		       games();
+	}
+};
+
+double eloToScore(double elo) {
+	return 1 / (1 + std::pow(10.0, -elo / 400));
+}
+
+double scoreToElo(double score) {
+	score = std::clamp(score, 1e-6, 1 - 1e-6);
+	return -400 * std::log10(1 / score - 1);
+}
+
+// Generalised SPRT on the mean score, the normal approximation match runners commonly use. Zero
+// until every outcome has been seen, as a run of only wins has no variance to estimate.
+double logLikelihoodRatio(const Score& score, double elo0, double elo1) {
+	if (score.wins == 0 || score.draws == 0 || score.losses == 0)
+		return 0;
+	double s0 = eloToScore(elo0);
+	double s1 = eloToScore(elo1);
+	return (s1 - s0) * (2 * score.mean() - s0 - s1) * score.games() / (2 * score.variance());
+}
+
+} // namespace
+
+int32_t main(int32_t argc, char* argv[]) {
+	// An engine that dies mid-match must not take the whole match down on the next write
+	std::signal(SIGPIPE, SIG_IGN);
+	Settings settings;
+	settings.concurrency = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	std::string openings_path;
+	int engines_given{0};
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg{argv[i]};
+		if (arg == "--games" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], settings.games, 1)) {
+				std::println(stderr, "invalid game count: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--concurrency" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], settings.concurrency, 1)) {
+				std::println(stderr, "invalid concurrency: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--depth" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], settings.limits.depth, 1)) {
+				std::println(stderr, "invalid depth: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--movetime" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], settings.limits.movetime_ms, 1)) {
+				std::println(stderr, "invalid movetime: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--tc" && i + 1 < argc) {
+			if (!parseTimeControl(argv[++i], settings.time_control)) {
+				std::println(stderr, "invalid time control: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--hash-mb" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], settings.hash_mb, 1)) {
+				std::println(stderr, "invalid hash size: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--openings" && i + 1 < argc) {
+			openings_path = argv[++i];
+		} else if (arg == "--pgn" && i + 1 < argc) {
+			settings.pgn_path = argv[++i];
+		} else if (arg == "--sprt" && i + 1 < argc) {
+			std::string_view bounds{argv[++i]};
+			size_t comma = bounds.find(',');
+			settings.sprt = comma != std::string_view::npos &&
+					parseNumber(bounds.substr(0, comma), settings.elo0) &&
+					parseNumber(bounds.substr(comma + 1), settings.elo1) &&
+					settings.elo0 < settings.elo1;
+			if (!settings.sprt) {
+				std::println(stderr, "invalid SPRT bounds: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if ((arg == "--alpha" || arg == "--beta") && i + 1 < argc) {
+			double& p = arg == "--alpha" ? settings.alpha : settings.beta;
+			if (!parseNumber(argv[++i], p) || p <= 0 || p >= 0.5) {
+				std::println(stderr, "invalid error probability: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (!arg.starts_with("--") && engines_given < 2) {
+			if (!parseEngine(arg, settings.engines[engines_given++])) {
+				std::println(stderr, "invalid engine: {}", arg);
+				return EXIT_FAILURE;
+			}
+		} else {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (engines_given != 2) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	Bitboards::init();
+	if (!openings_path.empty()) {
+		settings.openings = readEpd(openings_path);
+		if (settings.openings.empty()) {
+			std::println(stderr, "no openings in {}", openings_path);
+			return EXIT_FAILURE;
+		}
+	}
+
+	FILE* pgn = nullptr;
+	if (!settings.pgn_path.empty() && !(pgn = std::fopen(settings.pgn_path.c_str(), "a"))) {
+		std::println(stderr, "cannot write {}", settings.pgn_path);
+		return EXIT_FAILURE;
+	}
+
+	double lower = std::log(settings.beta / (1 - settings.alpha));
+	double upper = std::log((1 - settings.beta) / settings.alpha);
+	std::mutex results_mutex;
+	Score score;
+	std::atomic<int> next_game{0};
+	std::atomic<bool> stopping{false};
+	std::atomic<bool> failed{false};
+	auto start = std::chrono::steady_clock::now();
+
+	// Every thread keeps its two engines for all of its games
+	auto worker = [&] {
+		Waker waker;
+		std::array<std::unique_ptr<Engine>, 2> engines;
+		for (int i = 0; i < 2; i++) {
+			engines[i] = launch(settings.engines[i], settings.hash_mb, waker);
+			if (!engines[i]) {
+				std::println(stderr, "cannot start {}", settings.engines[i].path);
+				failed = true;
+				stopping = true;
+				return;
+			}
+		}
+
+		int index;
+		while (!stopping && (index = next_game++) < settings.games) {
+			// Both engines play every opening once with each colour
+			const std::string& opening =
+					settings.openings[static_cast<size_t>(index / 2) % settings.openings.size()];
+			PlayedGame played = playGame(settings, index + 1, opening, engines, index % 2, waker);
+			if (!engines[0] || !engines[1]) {
+				std::println(stderr, "cannot restart a stalled engine");
+				failed = true;
+				stopping = true;
+			}
+
+			std::lock_guard lock(results_mutex);
+			bool first_white = played.white == 0;
+			switch (played.game.outcome()) {
+			case GameResult::WHITE_WINS:
+				(first_white ? score.wins : score.losses)++;
+				break;
+			case GameResult::BLACK_WINS:
+				(first_white ? score.losses : score.wins)++;
+				break;
+			case GameResult::DRAW:
+				score.draws++;
+				break;
+			case GameResult::ONGOING:
+			default:
+				break;
+			}
+			if (pgn) {
+				std::string text = toPgn(settings, played);
+				std::fwrite(text.data(), 1, text.size(), pgn);
+				std::fflush(pgn);
+			}
+
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			double hours = std::chrono::duration<double>(elapsed).count() / 3600;
+			double margin = 1.96 * std::sqrt(score.variance() / score.games());
+			std::string line = std::format("game {} {} ({}) | +{} ={} -{}", played.round,
+					toString(played.game.outcome()), played.termination, score.wins, score.draws,
+					score.losses);
+			line += std::format(" | Elo {:+.1f} [{:+.1f}, {:+.1f}]", scoreToElo(score.mean()),
+					scoreToElo(score.mean() - margin), scoreToElo(score.mean() + margin));
+			if (settings.sprt) {
+				double llr = logLikelihoodRatio(score, settings.elo0, settings.elo1);
+				line += std::format(" | LLR {:.2f} [{:.2f}, {:.2f}]", llr, lower, upper);
+				if (llr <= lower || llr >= upper)
+					stopping = true;
+			}
+			std::println(stderr, "{} | {:.0f} games/hour", line, score.games() / hours);
+		}
+	};
+
+	{
+		std::vector<std::jthread> threads;
+		int count = std::min(settings.concurrency, settings.games);
+		for (int i = 0; i < count; i++)
+			threads.emplace_back(worker);
+	}
+	if (pgn)
+		std::fclose(pgn);
+
+	double elapsed =
+			std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (score.games() == 0)
+		return EXIT_FAILURE;
+	std::println("{:.0f} games/hour: {} games in {:.1f} s with {} concurrent",
+			score.games() * 3600 / elapsed, score.games(), elapsed, settings.concurrency);
+	std::println("{} vs {}: +{} ={} -{}, Elo {:+.1f}", settings.engines[0].name,
+			settings.engines[1].name, score.wins, score.draws, score.losses,
+			scoreToElo(score.mean()));
+	if (settings.sprt) {
+		double llr = logLikelihoodRatio(score, settings.elo0, settings.elo1);
+		const char* verdict = llr >= upper ? "H1 accepted" :
+				      llr <= lower ? "H0 accepted" :
+						     "inconclusive";
+		std::println("SPRT [{}, {}] LLR {:.2f}: {}", settings.elo0, settings.elo1, llr, verdict);
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
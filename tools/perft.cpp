@@ -0,0 +1,212 @@
+// Counts the leaf nodes of the legal move tree of a position. With --suite it checks the move
+// generator against published reference counts and fails on the first mismatch; --scaling
+// repeats the count with 1, 2, 4, ... threads up to --threads.
+#include "perft.hpp"
+#include "position.hpp"
+#include "thread_pool.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <print>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+struct Reference {
+	const char* name;
+	const char* fen;
+	int depth;
+	uint64_t nodes;
+};
+
+// Depths are picked to keep the whole suite at a few seconds in a debug build
+constexpr Reference suite[] = {
+	{"initial", Position::start_fen, 5, 4865609},
+	{"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4,
+		4085603},
+	{"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+	{"promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333},
+	{"discovered promotion", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4,
+		2103487},
+	{"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4,
+		3894594},
+	// en passant
+	{"ep exposes own king", "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888},
+	{"ep capture pinned", "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133},
+	{"ep gives check", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467},
+	// castling
+	{"short castle check", "5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072},
+	{"long castle check", "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711},
+	{"castling rights", "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206},
+	{"castling prevented", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476},
+	// promotion
+	{"promote out of check", "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+	{"promote to check", "4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342},
+	{"underpromote to check", "8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683},
+	// checks and game end
+	{"discovered check", "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658},
+	{"self stalemate", "K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217},
+	{"stalemate and mate", "8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+	{"stalemate and mate 2", "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527},
+};
+
+double seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void usage() {
+	std::println(stderr, "usage: perft [--fen FEN] [--depth N] [--divide] [--scaling]");
+	std::println(stderr, "             [--threads N] [--hash-mb N]");
+	std::println(stderr, "       perft --suite [--threads N] [--hash-mb N]");
+}
+
+bool parseNumber(std::string_view value, int& out, int min) {
+	auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), out);
+	return ec == std::errc{} && ptr == value.data() + value.size() && out >= min;
+}
+
+uint64_t count(Position& pos, int depth, PerftHash* hash, ThreadPool* pool) {
+	if (!pool)
+		return perft(pos, depth, hash);
+	uint64_t nodes{0};
+	for (const DivideEntry& entry : perftDivide(pos, depth, hash, pool))
+		nodes += entry.nodes;
+	return nodes;
+}
+
+int runSuite(PerftHash* hash, ThreadPool* pool) {
+	uint64_t total{0};
+	int failed{0};
+	auto start = std::chrono::steady_clock::now();
+	for (const Reference& ref : suite) {
+		Position pos;
+		pos.setFEN(ref.fen);
+		uint64_t nodes = count(pos, ref.depth, hash, pool);
+		total += nodes;
+		bool ok = nodes == ref.nodes;
+		if (!ok)
+			failed++;
+		std::println("{:<22} depth {} {:>10} {}", ref.name, ref.depth, nodes,
+				ok ? "ok" : "FAIL");
+		if (!ok)
+			std::println("  expected {} for {}", ref.nodes, ref.fen);
+	}
+	double elapsed = seconds(start);
+	std::println("{} nodes in {:.2f} s, {:.0f} nodes/second", total, elapsed, total / elapsed);
+	if (failed)
+		std::println("{} of {} positions FAILED", failed, std::size(suite));
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Speedup is measured against the single-thread run; the hash starts empty for every run
+void runScaling(Position& pos, int depth, int max_threads, PerftHash* hash) {
+	std::vector<int> thread_counts;
+	for (int n = 1; n < max_threads; n *= 2)
+		thread_counts.push_back(n);
+	thread_counts.push_back(max_threads);
+
+	std::println("threads {:>14} {:>9} {:>14} {:>8} {:>10}", "nodes", "time", "nodes/s",
+			"speedup", "efficiency");
+	double base{0};
+	for (int threads : thread_counts) {
+		if (hash)
+			hash->clear();
+		ThreadPool pool(static_cast<size_t>(threads));
+		auto start = std::chrono::steady_clock::now();
+		uint64_t nodes = count(pos, depth, hash, &pool);
+		double elapsed = seconds(start);
+		if (threads == 1)
+			base = elapsed;
+		double speedup = base / elapsed;
+		std::println("{:>7} {:>14} {:>8.3f}s {:>14.0f} {:>7.2f}x {:>9.1f}%", threads, nodes,
+				elapsed, nodes / elapsed, speedup, 100 * speedup / threads);
+	}
+}
+
+} // namespace
+
+int32_t main(int32_t argc, char* argv[]) {
+	std::string_view fen{Position::start_fen};
+	int depth{5};
+	int threads{1};
+	int hash_mb{0};
+	bool divide{false};
+	bool run_suite{false};
+	bool scaling{false};
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg{argv[i]};
+		if (arg == "--fen" && i + 1 < argc) {
+			fen = argv[++i];
+		} else if (arg == "--depth" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], depth, 1)) {
+				std::println(stderr, "invalid depth: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--threads" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], threads, 1)) {
+				std::println(stderr, "invalid thread count: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--hash-mb" && i + 1 < argc) {
+			if (!parseNumber(argv[++i], hash_mb, 0)) {
+				std::println(stderr, "invalid hash size: {}", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--divide") {
+			divide = true;
+		} else if (arg == "--suite") {
+			run_suite = true;
+		} else if (arg == "--scaling") {
+			scaling = true;
+		} else {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	Bitboards::init();
+	std::unique_ptr<PerftHash> hash;
+	if (hash_mb > 0) {
+		hash = std::make_unique<PerftHash>(static_cast<size_t>(hash_mb));
+		std::println("hash: {} entries", hash->entryCount());
+	}
+	std::unique_ptr<ThreadPool> pool;
+	if (threads > 1 && !scaling)
+		pool = std::make_unique<ThreadPool>(static_cast<size_t>(threads));
+
+	if (run_suite)
+		return runSuite(hash.get(), pool.get());
+
+	Position pos;
+	if (!pos.setFEN(fen)) {
+		std::println(stderr, "invalid FEN: {}", fen);
+		return EXIT_FAILURE;
+	}
+
+	if (scaling) {
+		runScaling(pos, depth, threads, hash.get());
+		return EXIT_SUCCESS;
+	}
+
+	uint64_t nodes{0};
+	auto start = std::chrono::steady_clock::now();
+	if (divide) {
+		for (const DivideEntry& entry : perftDivide(pos, depth, hash.get(), pool.get())) {
+			std::println("{}: {}", entry.move.toUci(), entry.nodes);
+			nodes += entry.nodes;
+		}
+		std::println("");
+	} else {
+		nodes = count(pos, depth, hash.get(), pool.get());
+	}
+	double elapsed = seconds(start);
+
+	std::println("depth {} nodes {}", depth, nodes);
+	std::println("time {:.3f} s, {:.0f} nodes/second", elapsed, nodes / elapsed);
+	return EXIT_SUCCESS;
+}